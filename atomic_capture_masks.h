@@ -2,15 +2,58 @@
 #define ATOMIC_CAPTURE_MASKS
 
 #include "bitboard.h"
+#include "bitboard_lookup.h"
 #include "chess_types.h"
 
 #include <array>
 
 /// Lookup table for atomic capture masks (the "blast radius" of a capture).
 /// Should include epicentre of the explosion.
+/// Blasts are symmetric, so atomicMasks[sq] is also the set of blast centres
+/// that would remove a (non-pawn) unit on sq, e.g. a king.
 
-extern std::array<Bitboard, NUM_SQUARES> atomicMasks;
+constexpr std::array<Bitboard, NUM_SQUARES> generateAtomicMasks() {
+    std::array<Bitboard, NUM_SQUARES> table {};
+    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+        Bitboard bb {bbFromSq(square(isq))};
+        bb |= ( shiftN(bb) | shiftNE(bb) | shiftE(bb) | shiftSE(bb) |
+               shiftS(bb) | shiftSW(bb) | shiftW(bb) | shiftNW(bb) );
+        table[isq] = bb;
+    }
+    return table;
+}
 
-void initialiseAtomicMasks();
+inline constexpr std::array<Bitboard, NUM_SQUARES> atomicMasks {
+    generateAtomicMasks()
+};
 
-#endif //#ifndef ATOMIC_CAPTURE_MASKS
\ No newline at end of file
+constexpr std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES>
+generateBlastRays() {
+    // Walk each ray out of sq, collecting squares once it enters the blast.
+    std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES> table {};
+    for (int icentre = 0; icentre < NUM_SQUARES; ++icentre) {
+        for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+            Bitboard bbRays {BB_NONE};
+            for (auto shift : RAY_SHIFTS) {
+                bool isBehind {false};
+                Bitboard bb {shift(bbFromSq(square(isq)))};
+                for (; bb; bb = shift(bb)) {
+                    isBehind = isBehind || (bb & atomicMasks[icentre]);
+                    if (isBehind) {
+                        bbRays |= bb;
+                    }
+                }
+            }
+            table[icentre][isq] = bbRays;
+        }
+    }
+    return table;
+}
+
+/// Indexed by [blast centre][square]. The squares along the eight rays out
+/// of square from the first one inside the blast radius to the board edge:
+/// where a slider uncovered by the blast on the square could stand.
+inline constexpr std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES>
+blastRays {generateBlastRays()};
+
+#endif //#ifndef ATOMIC_CAPTURE_MASKS
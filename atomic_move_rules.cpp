@@ -7,6 +7,7 @@
 #include "move.h"
 #include "position.h"
 
+#include <initializer_list>
 
 bool AtomicMoveRules::isLegal(Move mv, Position& pos) {
     /// Tests valid moves for legality. (Assumes move is valid.)
@@ -17,8 +18,8 @@ bool AtomicMoveRules::isLegal(Move mv, Position& pos) {
     if (pos.isVariantEnd()) {
         return false;
     }
-    // If en passant or castling, just treat them naively.
-    if (isEp(mv) || isCastling(mv)) {
+    // Castling is rare enough to just treat naively.
+    if (isCastling(mv)) {
         return isLegalNaive(mv, pos);
     }
     const Colour co {pos.getSideToMove()};
@@ -37,12 +38,16 @@ bool AtomicMoveRules::isLegal(Move mv, Position& pos) {
             return isOk;
         }
     }
+    const LegalityContext ctx {findLegalityContext(pos)};
+    if (isEp(mv)) {
+        return isEpLegal(fromSq, toSq, pos, ctx);
+    }
     // Always check captures. En passant not handled by this.
     if (pos.getMailbox(toSq) != NO_PIECE) {
-        return isCaptureLegal(fromSq, toSq, pos);
+        return isCaptureLegal(fromSq, toSq, pos, ctx);
     }
     // If not a king move and not a capture (and not ep/castling), verify.
-    return isLegalNonKingNonCapture(fromSq, toSq, pos);
+    return isLegalNonKingNonCapture(fromSq, toSq, ctx);
 }
 
 bool AtomicMoveRules::isInCheck(Colour co, const Position& pos) {
@@ -68,8 +73,73 @@ bool AtomicMoveRules::isInCheck(Colour co, const Position& pos) {
     }
 }
 
-Movelist AtomicMoveRules::generateLegalMoves(Position& pos) {
-    return generateLegalMovesByType(pos);
+Movelist& AtomicMoveRules::generateLegalMoves(Movelist& mvlist, Position& pos) {
+    mvlist.clear();
+    return generateLegalMovesByType(mvlist, pos, ALL_MOVES);
+}
+
+Movelist& AtomicMoveRules::generateLegalMoves(Movelist& mvlist, Position& pos,
+                                              GenType type) {
+    mvlist.clear();
+    if (type == QUIET_CHECKS) {
+        generateLegalMovesByType(mvlist, pos, QUIETS);
+        return keepChecks(mvlist, pos);
+    }
+    return generateLegalMovesByType(mvlist, pos, type);
+}
+
+Movelist& AtomicMoveRules::generateLegalMovesTo(Movelist& mvlist,
+                                                Position& pos, PieceType pcty,
+                                                Square toSq) {
+    /// Runs only the per-piece generator of pcty, with the destinations
+    /// narrowed down to toSq through the legality context.
+    mvlist.clear();
+    if (pos.isVariantEnd()) {
+        return mvlist;
+    }
+    LegalityContext ctx {findLegalityContext(pos)};
+    ctx.bbDest = bbFromSq(toSq);
+    switch (pcty) {
+        case KING:
+            addLegalKingMoves(mvlist, pos, ctx);
+            addLegalCastlingMoves(mvlist, pos);
+            return removeCastlingNotTo(mvlist, toSq);
+        case KNIGHT:
+            return addLegalKnightMoves(mvlist, pos, ctx);
+        case PAWN:
+            addLegalPawnMoves(mvlist, pos, ctx);
+            if (toSq == pos.getEpSq()) {
+                addLegalEpMoves(mvlist, pos, ctx);
+            }
+            return mvlist;
+        default:
+            return addLegalSliderMoves(mvlist, pos, ctx, pcty);
+    }
+}
+
+bool AtomicMoveRules::hasLegalMove(Position& pos) {
+    /// Counts one piece type at a time, stopping at the first that has a
+    /// legal move: king, then cheap leapers and pawns, then sliders, then the
+    /// rare ep and castling. (Unlike orthochess, double check does not leave
+    /// only king moves, since a blast can remove both checkers.)
+    if (pos.isVariantEnd()) {
+        return false;
+    }
+    const LegalityContext ctx {findLegalityContext(pos)};
+    MoveCounter counter {};
+    return addLegalKingMoves(counter, pos, ctx).size() > 0
+           || addLegalKnightMoves(counter, pos, ctx).size() > 0
+           || addLegalPawnMoves(counter, pos, ctx).size() > 0
+           || addLegalSliderMoves(counter, pos, ctx, BISHOP).size() > 0
+           || addLegalSliderMoves(counter, pos, ctx, ROOK).size() > 0
+           || addLegalSliderMoves(counter, pos, ctx, QUEEN).size() > 0
+           || addLegalEpMoves(counter, pos, ctx).size() > 0
+           || addLegalCastlingMoves(counter, pos).size() > 0;
+}
+
+int AtomicMoveRules::countLegalMoves(Position& pos) {
+    MoveCounter counter {};
+    return generateLegalMovesByType(counter, pos, ALL_MOVES).size();
 }
 
 bool AtomicMoveRules::isLegalNaive(Move mv, Position& pos) {
@@ -107,11 +177,20 @@ bool AtomicMoveRules::isCheckAttacked(Square sq, Colour co,
            && attacksTo(sq, co, pos);
 }
 
-Movelist AtomicMoveRules::generateLegalMovesNaive(Position& pos) {
+Bitboard AtomicMoveRules::findCheckAttacked(Colour co, const Position& pos) {
+    /// Returns all squares where an enemy king would be in check by co: those
+    /// attacked (kings never attack), except next to co's own king.
+    const Bitboard bbKing {pos.getUnitsBb(co, KING)};
+    const Bitboard bbConnected {bbKing ? atomicMasks[lsb(bbKing)] : BB_NONE};
+    return pos.getAttacksBb(co) & ~bbConnected;
+}
+
+Movelist& AtomicMoveRules::generateLegalMovesNaive(Movelist& mvlist,
+                                                   Position& pos) {
     /// Generates all legal moves in the position naively: first generates all
     /// valid moves, then checks each for legality.
     Colour co {pos.getSideToMove()};
-    Movelist mvlist {};
+    mvlist.clear();
     // Start generating valid moves.
     addKingMoves(mvlist, co, pos);
     addKnightMoves(mvlist, co, pos);
@@ -132,67 +211,215 @@ Movelist AtomicMoveRules::generateLegalMovesNaive(Position& pos) {
     return mvlist;
 }
 
-Movelist AtomicMoveRules::generateLegalMovesByType(Position& pos) {
-    /// Directly generates all legal moves in the position by piece type.
-    ///
-    Colour co {pos.getSideToMove()};
-    Movelist mvlist {};
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::generateLegalMovesByType(MoveSink& mvlist,
+                                                    const Position& pos,
+                                                    GenType type) {
+    /// Directly generates the legal moves of a given kind (not QUIET_CHECKS)
+    /// in the position by piece type, appending them to mvlist. Never
+    /// modifies the position.
     if (pos.isVariantEnd()) {
         return mvlist;
     }
-    // Start generating valid moves -- begin with ep and castling.
-    addEpMoves(mvlist, co, pos);
-    addCastlingMoves(mvlist, co, pos);
-    // Test for legality naively for these.
-    for (auto it = mvlist.begin(); it != mvlist.end();) {
-        if (isLegalNaive(*it, pos)) {
-            ++it;
-        } else {
-            it = mvlist.erase(it);
-        }
+    LegalityContext ctx {findLegalityContext(pos)};
+    // Checks are only real if the kings are not connected.
+    if (type == EVASIONS && (!ctx.bbCheckers || ctx.isConnectedKings)) {
+        return mvlist;
+    }
+    if (type == CAPTURES) {
+        ctx.bbDest = pos.getUnitsBb(!pos.getSideToMove());
+    } else if (type == QUIETS) {
+        ctx.bbDest = ~pos.getUnitsBb();
+    }
+    // Start generating moves -- begin with ep and castling.
+    if (type != QUIETS) {
+        addLegalEpMoves(mvlist, pos, ctx);
+    }
+    if (type != CAPTURES) {
+        addLegalCastlingMoves(mvlist, pos);
     }
     // Generating by piece, rather than by capture/quiet/etc, since this will be
     // useful for PGN validation, which gives a known piece type for each move.
-    addLegalKingMoves(mvlist, pos);
-    addLegalKnightMoves(mvlist, pos);
-    addLegalSliderMoves(mvlist, pos, BISHOP);
-    addLegalSliderMoves(mvlist, pos, ROOK);
-    addLegalSliderMoves(mvlist, pos, QUEEN);
-    addLegalPawnMoves(mvlist, pos);
+    addLegalKingMoves(mvlist, pos, ctx);
+    addLegalKnightMoves(mvlist, pos, ctx);
+    addLegalSliderMoves(mvlist, pos, ctx, BISHOP);
+    addLegalSliderMoves(mvlist, pos, ctx, ROOK);
+    addLegalSliderMoves(mvlist, pos, ctx, QUEEN);
+    addLegalPawnMoves(mvlist, pos, ctx);
+    return mvlist;
+}
+
+AtomicMoveRules::LegalityContext AtomicMoveRules::findLegalityContext(
+        const Position& pos) {
+    /// Computes the king's legality information for the side to move.
+    /// Assumes there is exactly one king per side.
+    const Colour co {pos.getSideToMove()};
+    LegalityContext ctx {};
+    ctx.kingSq = lsb(pos.getUnitsBb(co, KING));
+    ctx.isConnectedKings = isConnectedKings(pos);
+    ctx.bbCheckers = attacksTo(ctx.kingSq, !co, pos);
+    ctx.bbPinned = IMoveRules::findPinned(co, pos);
+    ctx.bbBlock = BB_NONE;
+    ctx.bbDest = BB_ALL;
+    // Contact checks (pawn, knight) cannot be blocked, and lineBetween is
+    // empty for them anyway.
+    if (ctx.bbCheckers && isSingle(ctx.bbCheckers)) {
+        ctx.bbBlock = lineBetween[lsb(ctx.bbCheckers)][ctx.kingSq];
+    }
+    
+    // Capture legality depends (almost) only on the blast centre, so it is
+    // worked out for all targets at once, as sets of centres.
+    // A unit on sq is removed by blasts centred on blastsRemoving(sq): any
+    // centre next to it, but only a direct capture for pawns.
+    const Bitboard bbPawns {pos.getUnitsBb(PAWN)};
+    auto blastsRemoving = [bbPawns](Square sq) {
+        return (sq & bbPawns) ? bbFromSq(sq) : atomicMasks[sq];
+    };
+    const Bitboard bbEnemy {pos.getUnitsBb(!co)};
+    // Blasts touching our own king are never legal.
+    ctx.bbCaptureTargets = bbEnemy & ~atomicMasks[ctx.kingSq];
+    ctx.bbXrayLines = BB_NONE;
+    if (ctx.isConnectedKings) {
+        return ctx;
+    }
+    // Every checker must be destroyed...
+    Bitboard bbOk {BB_ALL};
+    Bitboard bb {ctx.bbCheckers};
+    while (bb) {
+        bbOk &= blastsRemoving(popLsb(bb));
+    }
+    // ...and no slider may be uncovered: a slider aligned with the king is
+    // revealed if every unit between them is removed but it survives.
+    const Bitboard bbAll {pos.getUnitsBb()};
+    const Bitboard bbQueens {pos.getUnitsBb(!co, QUEEN)};
+    Bitboard bbSliders {
+        (findRookAttacks(ctx.kingSq, BB_NONE)
+         & (pos.getUnitsBb(!co, ROOK) | bbQueens))
+        | (findBishopAttacks(ctx.kingSq, BB_NONE)
+           & (pos.getUnitsBb(!co, BISHOP) | bbQueens))
+    };
+    while (bbSliders) {
+        const Square sliderSq {popLsb(bbSliders)};
+        const Bitboard bbLine {lineBetween[sliderSq][ctx.kingSq]};
+        ctx.bbXrayLines |= bbLine;
+        Bitboard bbReveals {~atomicMasks[sliderSq]};
+        Bitboard bbBlockers {bbLine & bbAll};
+        while (bbBlockers) {
+            bbReveals &= blastsRemoving(popLsb(bbBlockers));
+        }
+        bbOk &= ~bbReveals;
+    }
+    // Exploding the enemy king wins regardless.
+    bbOk |= atomicMasks[lsb(pos.getUnitsBb(!co, KING))];
+    ctx.bbCaptureTargets &= bbOk;
+    return ctx;
+}
+
+Bitboard AtomicMoveRules::findLegalCaptures(Square fromSq, Bitboard bbCaptures,
+                                            const Position& pos,
+                                            const LegalityContext& ctx) {
+    /// Returns the legal subset of the (valid) captures from fromSq.
+    /// Only a unit on a line to an aligned enemy slider needs checking one
+    /// capture at a time, since vacating fromSq may uncover that slider.
+    if (!(fromSq & ctx.bbXrayLines)) {
+        return bbCaptures & ctx.bbCaptureTargets;
+    }
+    Bitboard bbLegal {BB_NONE};
+    while (bbCaptures) {
+        const Square toSq {popLsb(bbCaptures)};
+        if (isCaptureLegal(fromSq, toSq, pos, ctx)) {
+            bbLegal |= toSq;
+        }
+    }
+    return bbLegal;
+}
+
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalEpMoves(MoveSink& mvlist,
+                                           const Position& pos,
+                                           const LegalityContext& ctx) {
+    const Colour co {pos.getSideToMove()};
+    const Square toSq {pos.getEpSq()};
+    if (toSq == NO_SQ) {
+        return mvlist;
+    }
+    // A [Colour] pawn can capture onto toSq from where a [!Colour] pawn on
+    // toSq would attack.
+    Bitboard bbFrom {pawnAttacks[!co][toSq] & pos.getUnitsBb(co, PAWN)};
+    while (bbFrom) {
+        const Square fromSq {popLsb(bbFrom)};
+        if (isEpLegal(fromSq, toSq, pos, ctx)) {
+            mvlist.push_back(buildEp(fromSq, toSq));
+        }
+    }
+    return mvlist;
+}
+
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalCastlingMoves(MoveSink& mvlist,
+                                                 const Position& pos) {
+    const Colour co {pos.getSideToMove()};
+    const CastlingRights crShort {(co == WHITE) ? CASTLE_WSHORT
+                                                : CASTLE_BSHORT};
+    const CastlingRights crLong {(co == WHITE) ? CASTLE_WLONG : CASTLE_BLONG};
+    for (CastlingRights cr : {crShort, crLong}) {
+        if (isCastlingValid(cr, pos) && isCastlingLegal(cr, pos)) {
+            mvlist.push_back(buildCastling(pos.getOrigKingSq(cr),
+                                           pos.getOrigRookSq(cr)));
+        }
+    }
     return mvlist;
 }
 
-Movelist& AtomicMoveRules::addLegalKingMoves(Movelist& mvlist, Position& pos) {
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalKingMoves(MoveSink& mvlist,
+                                             const Position& pos,
+                                             const LegalityContext& ctx) {
     const Colour co {pos.getSideToMove()};
     Bitboard bbFrom = pos.getUnitsBb(co, KING);
     const Bitboard bbAll = pos.getUnitsBb();
+    const Bitboard bbEnemyKing = pos.getUnitsBb(!co, KING);
     // Verify that king's destination square is not occupied (kings can't
     // capture) and not check-attacked (can be attacked if enemy king is
-    // adjacent). Ghost/unghost king for the latter.
+    // adjacent). The king is taken out of the occupancy for the latter, so it
+    // cannot shield itself.
     while (bbFrom) {
         Square fromSq {popLsb(bbFrom)};
-        pos.ghostKing(co, fromSq);
-        Bitboard bbTo {kingAttacks[fromSq] & ~bbAll};
+        const Bitboard bbOcc {bbAll ^ fromSq};
+        Bitboard bbTo {kingAttacks[fromSq] & ~bbAll & ctx.bbDest};
+        // If no slider attacks the king, none sees through it, so the attack
+        // map of the position as-is is exact.
+        if (isUsingAttackMaps && !ctx.bbCheckers) {
+            bbTo &= ~findCheckAttacked(!co, pos);
+            while (bbTo) {
+                mvlist.push_back(buildMove(fromSq, popLsb(bbTo)));
+            }
+            continue;
+        }
         while (bbTo) {
             Square toSq {popLsb(bbTo)};
-            if (!isCheckAttacked(toSq, !co, pos)) {
+            if ((atomicMasks[toSq] & bbEnemyKing)
+                || !attacksTo(toSq, !co, bbOcc, pos)) {
                 mvlist.push_back(buildMove(fromSq, toSq));
             }
         }
-        pos.unghostKing(co, fromSq);
     }
     
     return mvlist;
 }
 
-Movelist& AtomicMoveRules::addLegalSliderMoves(Movelist& mvlist, Position& pos,
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalSliderMoves(MoveSink& mvlist,
+                                               const Position& pos,
+                                               const LegalityContext& ctx,
                                                PieceType pcty) {
     /// Among normal pieces, the rook, bishop, and queen are sliders.
     ///
     const Colour co {pos.getSideToMove()};
     Bitboard bbFrom {pos.getUnitsBb(co, pcty)};
-    const Bitboard bbFriendly {pos.getUnitsBb(co)};
+    const Bitboard bbEnemy {pos.getUnitsBb(!co) & ctx.bbDest};
     const Bitboard bbAll {pos.getUnitsBb()};
+    const Bitboard bbEmpty {~bbAll & ctx.bbDest};
     while (bbFrom) {
         Square fromSq {popLsb(bbFrom)};
         Bitboard bbTo {BB_NONE};
@@ -202,16 +429,15 @@ Movelist& AtomicMoveRules::addLegalSliderMoves(Movelist& mvlist, Position& pos,
         if (pcty == ROOK || pcty == QUEEN) {
             bbTo |= findRookAttacks(fromSq, bbAll);
         }
-        bbTo &= ~bbFriendly;
+        Bitboard bbCaptures {findLegalCaptures(fromSq, bbTo & bbEnemy, pos,
+                                               ctx)};
+        while (bbCaptures) {
+            mvlist.push_back(buildMove(fromSq, popLsb(bbCaptures)));
+        }
+        bbTo &= bbEmpty;
         while (bbTo) {
             Square toSq {popLsb(bbTo)};
-            if (pos.getMailbox(toSq) != NO_PIECE) {
-                if (isCaptureLegal(fromSq, toSq, pos)) {
-                    mvlist.push_back(buildMove(fromSq, toSq));
-                }
-                continue;
-            }
-            if (isLegalNonKingNonCapture(fromSq, toSq, pos)) {
+            if (isLegalNonKingNonCapture(fromSq, toSq, ctx)) {
                 mvlist.push_back(buildMove(fromSq, toSq));
             }
         }
@@ -219,37 +445,35 @@ Movelist& AtomicMoveRules::addLegalSliderMoves(Movelist& mvlist, Position& pos,
     return mvlist;
 }
 
-Movelist& AtomicMoveRules::addLegalKnightMoves(Movelist& mvlist,
-                                               Position& pos) {
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalKnightMoves(MoveSink& mvlist,
+                                               const Position& pos,
+                                               const LegalityContext& ctx) {
     const Colour co {pos.getSideToMove()};
     Bitboard bbFrom {pos.getUnitsBb(co, KNIGHT)};
-    const Bitboard bbFriendly {pos.getUnitsBb(co)};
+    const Bitboard bbEnemy {pos.getUnitsBb(!co) & ctx.bbDest};
+    const Bitboard bbEmpty {~pos.getUnitsBb() & ctx.bbDest};
     while (bbFrom) {
         Square fromSq {popLsb(bbFrom)};
-        // TODO: separate to 2 bbTo bitboards -- one for captures, one for not.
-        Bitboard bbTo {knightAttacks[fromSq] & ~bbFriendly};
+        Bitboard bbCaptures {findLegalCaptures(
+            fromSq, knightAttacks[fromSq] & bbEnemy, pos, ctx)};
+        while (bbCaptures) {
+            mvlist.push_back(buildMove(fromSq, popLsb(bbCaptures)));
+        }
+        Bitboard bbTo {knightAttacks[fromSq] & bbEmpty};
         while (bbTo) {
             Square toSq {popLsb(bbTo)};
-            if (pos.getMailbox(toSq) != NO_PIECE) {
-                if (isCaptureLegal(fromSq, toSq, pos)) {
-                    mvlist.push_back(buildMove(fromSq, toSq));
-                }
-                continue;
-            }
-            if (isConnectedKings(pos)) {
+            if (ctx.isConnectedKings) {
                 mvlist.push_back(buildMove(fromSq, toSq));
                 continue;
             }
-            const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
-            const Bitboard bbCheckers {attacksTo(kingSq, !co, pos)};
-            if (bbCheckers) {
-                if (isInterpositionLegal(fromSq, toSq, pos)) {
+            if (ctx.bbCheckers) {
+                if (isInterpositionLegal(fromSq, toSq, ctx)) {
                     mvlist.push_back(buildMove(fromSq, toSq));
                 }
                 continue;
             }
-            const Bitboard bbPinned {IMoveRules::findPinned(co, pos)};
-            if (fromSq & bbPinned) {
+            if (fromSq & ctx.bbPinned) {
                 // Knights cannot move along a pin ray.
                 // (unless there are nightriders...)
                 continue;
@@ -260,36 +484,42 @@ Movelist& AtomicMoveRules::addLegalKnightMoves(Movelist& mvlist,
     return mvlist;
 }
 
-Movelist& AtomicMoveRules::addLegalPawnMoves(Movelist& mvlist, Position& pos) {
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalPawnMoves(MoveSink& mvlist,
+                                             const Position& pos,
+                                             const LegalityContext& ctx) {
     /// Adds legal pawn pushes, captures and promotions. Does not generate en
     /// passant captures.
-    addLegalPawnCaptures(mvlist, pos);
-    addLegalPawnPushes(mvlist, pos);
-    addLegalPawnDoublePushes(mvlist, pos);
+    addLegalPawnCaptures(mvlist, pos, ctx);
+    addLegalPawnPushes(mvlist, pos, ctx);
+    addLegalPawnDoublePushes(mvlist, pos, ctx);
     return mvlist;
 }
 
-Movelist& AtomicMoveRules::addLegalPawnCaptures(Movelist& mvlist,
-                                                Position& pos) {
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalPawnCaptures(MoveSink& mvlist,
+                                                const Position& pos,
+                                                const LegalityContext& ctx) {
     /// Adds legal pawn captures (including capture-promotions). Does not
     /// generate en passant captures.
     const Colour co {pos.getSideToMove()};
     Bitboard bbFrom {pos.getUnitsBb(co, PAWN)};
-    const Bitboard bbEnemy {pos.getUnitsBb(!co)};
+    const Bitboard bbEnemy {pos.getUnitsBb(!co) & ctx.bbDest};
     while (bbFrom) {
         Square fromSq {popLsb(bbFrom)};
-        Bitboard bbTo {pawnAttacks[co][fromSq] & bbEnemy};
+        Bitboard bbTo {findLegalCaptures(
+            fromSq, pawnAttacks[co][fromSq] & bbEnemy, pos, ctx)};
         while (bbTo) {
-            Square toSq {popLsb(bbTo)};
-            if (isCaptureLegal(fromSq, toSq, pos)) {
-                IMoveRules::addPawnMoves(mvlist, co, fromSq, toSq);
-            }
+            IMoveRules::addPawnMoves(mvlist, co, fromSq, popLsb(bbTo));
         }
     }
     return mvlist;
 }
 
-Movelist& AtomicMoveRules::addLegalPawnPushes(Movelist& mvlist, Position& pos) {
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalPawnPushes(MoveSink& mvlist,
+                                              const Position& pos,
+                                              const LegalityContext& ctx) {
     const Colour co {pos.getSideToMove()};
     Bitboard bbFrom {pos.getUnitsBb(co, PAWN)};
     Bitboard bbAll {pos.getUnitsBb()};
@@ -297,19 +527,21 @@ Movelist& AtomicMoveRules::addLegalPawnPushes(Movelist& mvlist, Position& pos) {
     while (bbFrom) {
         Square fromSq {popLsb(bbFrom)};
         Square toSq {shiftForward(fromSq, co)};
-        if (toSq & bbAll) {
-            // pawn push is blocked
+        if ((toSq & bbAll) || !(toSq & ctx.bbDest)) {
+            // pawn push is blocked (or not wanted)
             continue;
         }
-        if (isLegalNonKingNonCapture(fromSq, toSq, pos)) {
+        if (isLegalNonKingNonCapture(fromSq, toSq, ctx)) {
             IMoveRules::addPawnMoves(mvlist, co, fromSq, toSq);
         }
     }
     return mvlist;
 }
 
-Movelist& AtomicMoveRules::addLegalPawnDoublePushes(Movelist& mvlist,
-                                                    Position& pos) {
+template <typename MoveSink>
+MoveSink& AtomicMoveRules::addLegalPawnDoublePushes(MoveSink& mvlist,
+                                                    const Position& pos,
+                                                    const LegalityContext& ctx) {
     const Colour co {pos.getSideToMove()};
     Bitboard bbFrom {pos.getUnitsBb(co, PAWN) & BB_OUR_2[co]};
     Bitboard bbAll {pos.getUnitsBb()};
@@ -317,11 +549,12 @@ Movelist& AtomicMoveRules::addLegalPawnDoublePushes(Movelist& mvlist,
     while (bbFrom) {
         Square fromSq {popLsb(bbFrom)};
         Square toSq {shiftForward(shiftForward(fromSq, co), co)};
-        if ((shiftForward(fromSq, co) | toSq) & bbAll) {
-            // pawn push is blocked
+        if (((shiftForward(fromSq, co) | toSq) & bbAll)
+            || !(toSq & ctx.bbDest)) {
+            // pawn push is blocked (or not wanted)
             continue;
         }
-        if (isLegalNonKingNonCapture(fromSq, toSq, pos)) {
+        if (isLegalNonKingNonCapture(fromSq, toSq, ctx)) {
             mvlist.push_back(buildMove(fromSq, toSq));
         }
     }
@@ -331,14 +564,21 @@ Movelist& AtomicMoveRules::addLegalPawnDoublePushes(Movelist& mvlist,
 Bitboard AtomicMoveRules::attacksTo(Square sq, Colour co, const Position& pos) {
     /// Returns bitboard of units of a given colour that attack a given square.
     /// In atomic chess, kings cannot capture, so kings do not attack either.
+    return attacksTo(sq, co, pos.getUnitsBb(), pos);
+}
+
+Bitboard AtomicMoveRules::attacksTo(Square sq, Colour co, Bitboard bbAll,
+                                    const Position& pos) {
+    /// As above, but sliders see through the given occupancy bbAll instead.
+    /// (Units missing from bbAll are still returned if they attack.)
     
     // In chess, most piece types have the property that: if piece PC is on
     // square SQ_A attacking SQ_B, then from SQ_B it would attack SQ_A.
     Bitboard bbAttackers {BB_NONE};
     bbAttackers = knightAttacks[sq] & pos.getUnitsBb(co, KNIGHT);
-    bbAttackers |= findBishopAttacks(sq, pos.getUnitsBb())
+    bbAttackers |= findBishopAttacks(sq, bbAll)
                    & (pos.getUnitsBb(co, BISHOP) | pos.getUnitsBb(co, QUEEN));
-    bbAttackers |= findRookAttacks(sq, pos.getUnitsBb())
+    bbAttackers |= findRookAttacks(sq, bbAll)
                    & (pos.getUnitsBb(co, ROOK) | pos.getUnitsBb(co, QUEEN));
     // For pawns, a square SQ_A is attacked by a [Colour] pawn on SQ_B,
     // if a [!Colour] pawn on SQ_A would attack SQ_B.
@@ -347,7 +587,8 @@ Bitboard AtomicMoveRules::attacksTo(Square sq, Colour co, const Position& pos) {
 }
 
 bool AtomicMoveRules::isCaptureLegal(Square fromSq, Square toSq,
-                                     const Position& pos) {
+                                     const Position& pos,
+                                     const LegalityContext& ctx) {
     /// Assumes is not a king move nor en passant.
     ///
     // When is a capture legal/illegal?
@@ -357,21 +598,18 @@ bool AtomicMoveRules::isCaptureLegal(Square fromSq, Square toSq,
     // else it depends if one's own king is in check thereafter.
     // En passant is not handled by this.
     const Colour co {pos.getSideToMove()};
-    const Bitboard bbKing {pos.getUnitsBb(co, KING)};
-    const Bitboard bbEnemyKing {pos.getUnitsBb(!co, KING)};
-    const Square kingSq {lsb(bbKing)};
-    const bool isConnectedKings {bbEnemyKing & atomicMasks[kingSq]};
+    const Square kingSq {ctx.kingSq};
     // Check if move is atomic suicide, atomic win, or if kings remain adjacent.
-    if (bbKing & atomicMasks[toSq]) {
+    if (kingSq & atomicMasks[toSq]) {
         return false;
-    } else if (bbEnemyKing & atomicMasks[toSq]) {
+    } else if (pos.getUnitsBb(!co, KING) & atomicMasks[toSq]) {
         return true;
-    } else if (isConnectedKings) {
+    } else if (ctx.isConnectedKings) {
         return true;
     }
     // Checks are real only if kings are not connected.
     // Need to see if king is in check after explosion.
-    const Bitboard bbCheckers {attacksTo(kingSq, !co, pos)};
+    const Bitboard bbCheckers {ctx.bbCheckers};
     const Bitboard bbAll {pos.getUnitsBb()};
     Bitboard bbExploded = (atomicMasks[toSq]
                            & (bbAll & ~pos.getUnitsBb(PAWN)))
@@ -381,53 +619,83 @@ bool AtomicMoveRules::isCaptureLegal(Square fromSq, Square toSq,
     if ((bbCheckers & bbExploded) != bbCheckers) {
         return false;
     }
+    // No unit is added, so any check left must come from a slider uncovered
+    // by the blast or by vacating fromSq. (Knight and pawn checkers are
+    // among bbCheckers, so already destroyed.)
     Bitboard bb = bbAll & ~(bbExploded | fromSq);
+    const Bitboard bbQueens {pos.getUnitsBb(!co, QUEEN)};
+    const Bitboard bbRooks {(pos.getUnitsBb(!co, ROOK) | bbQueens) & bb};
+    const Bitboard bbBishops {(pos.getUnitsBb(!co, BISHOP) | bbQueens) & bb};
+    if (!((bbRooks | bbBishops)
+          & (blastRays[toSq][kingSq] | lineThrough[kingSq][fromSq]))) {
+        return true;
+    }
     // bb now represents the occupancy bitboard if the move were made.
     // Assumes this not a king move.
-    if (bb & knightAttacks[kingSq] & pos.getUnitsBb(!co, KNIGHT)) {
-        return false;
-    }
-    // kingSq is attacked by an enemy pawn if an own pawn on kingSq
-    // would attack that enemy pawn.
-    if (bb & pawnAttacks[co][kingSq] & pos.getUnitsBb(!co, PAWN)) {
-        return false;
-    }
-    // Checks line pieces for check.
-    if (bb & findRookAttacks(kingSq, bb) &
-        (pos.getUnitsBb(!co, ROOK) | pos.getUnitsBb(!co, QUEEN))) {
+    return !(findRookAttacks(kingSq, bb) & bbRooks)
+           && !(findBishopAttacks(kingSq, bb) & bbBishops);
+}
+
+bool AtomicMoveRules::isEpLegal(Square fromSq, Square toSq,
+                                const Position& pos,
+                                const LegalityContext& ctx) {
+    /// Tests an en passant capture directly. The blast is centred on the ep
+    /// square, but the captured pawn (which always explodes) stands behind it.
+    const Colour co {pos.getSideToMove()};
+    const Square capSq {(co == WHITE) ? shiftS(toSq) : shiftN(toSq)};
+    const Bitboard bbAll {pos.getUnitsBb()};
+    const Bitboard bbExploded {
+        (atomicMasks[toSq] & bbAll & ~pos.getUnitsBb(PAWN)) | capSq | fromSq
+    };
+    if (bbExploded & pos.getUnitsBb(co, KING)) {
         return false;
+    } else if (bbExploded & pos.getUnitsBb(!co, KING)) {
+        return true;
+    } else if (ctx.isConnectedKings) {
+        return true;
     }
-    if (bb & findBishopAttacks(kingSq, bb) &
-        (pos.getUnitsBb(!co, BISHOP) | pos.getUnitsBb(!co, QUEEN))) {
-        return false;
+    const Bitboard bbOcc {bbAll & ~bbExploded};
+    return !(attacksTo(ctx.kingSq, !co, bbOcc, pos) & bbOcc);
+}
+
+bool AtomicMoveRules::isCastlingLegal(CastlingRights cr, const Position& pos) {
+    /// Tests a valid castling for check on the king's final square, with king
+    /// and rook in their final places. (isCastlingValid only tests the path
+    /// as-is.) As there, a king next to the enemy king is never in check.
+    const Colour co {pos.getSideToMove()};
+    const Square kingToSq {SQ_K_TO[toIndex(cr)]};
+    const Square rookToSq {SQ_R_TO[toIndex(cr)]};
+    if (atomicMasks[kingToSq] & pos.getUnitsBb(!co, KING)) {
+        return true;
     }
-    return true;
+    const Bitboard bbOcc {
+        (pos.getUnitsBb() ^ pos.getOrigKingSq(cr) ^ pos.getOrigRookSq(cr))
+        | kingToSq | rookToSq
+    };
+    return !attacksTo(kingToSq, !co, bbOcc, pos);
 }
 
 bool AtomicMoveRules::isLegalNonKingNonCapture(Square fromSq, Square toSq,
-                                               const Position& pos) {
+                                               const LegalityContext& ctx) {
     /// Returns if the (valid) move described by from/to squares is legal.
     /// Assumes the move is not a king move or a capture (also not en passant
     /// nor castling), and additionally that the move described by the from/to
     /// squares is valid.
-    const Colour co {pos.getSideToMove()};
     // If kings are connected, then all non-capture non-king moves are fine.
     // Assumes this is not castling and not en passant.
-    if (isConnectedKings(pos)) {
+    if (ctx.isConnectedKings) {
         return true;
     } 
     // If kings are not connected, checkers are real; need to address check.
     // Note: checking pieces don't actually give check if kings are connected.
-    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
-    const Bitboard bbCheckers {attacksTo(kingSq, !co, pos)};
+    const Square kingSq {ctx.kingSq};
     // Captures and king moves already handled, so if in check, just need to
     // look for legal interpositions.
-    if (bbCheckers) {
-        return isInterpositionLegal(fromSq, toSq, pos);
+    if (ctx.bbCheckers) {
+        return isInterpositionLegal(fromSq, toSq, ctx);
     }
-    const Bitboard bbPinned {IMoveRules::findPinned(co, pos)};
     // Finally check for pinned pieces, which can only move along the pin line.
-    if (fromSq & bbPinned) {
+    if (fromSq & ctx.bbPinned) {
         return (lineBetween[fromSq][kingSq] & toSq) ||
                (lineBetween[toSq][kingSq] & fromSq);
     }
@@ -442,26 +710,10 @@ bool AtomicMoveRules::isConnectedKings(const Position& pos) {
 }
 
 bool AtomicMoveRules::isInterpositionLegal(Square fromSq, Square toSq,
-                                           const Position& pos) {
+                                           const LegalityContext& ctx) {
     /// True iff the from/to squares describe a legal interposition move.
-    /// Assumes the side to move is in check.
-    const Colour co {pos.getSideToMove()};
-    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
-    const Bitboard bbCheckers {attacksTo(kingSq, !co, pos)}; // assumed nonempty
-    const Bitboard bbPinned {IMoveRules::findPinned(co, pos)};
-    
-    if (!isSingle(bbCheckers)) {
-        return false;
-    } else {
-        Square checkerSq {lsb(bbCheckers)};
-        PieceType checkerType {getPieceType(pos.getMailbox(checkerSq))};
-        // Cannot interpose a contact check.
-        if (checkerType == PAWN || checkerType == KNIGHT) {
-            return false;
-        } else {
-            // Verify interposition for line pieces.
-            return ((fromSq & bbPinned) == BB_NONE) &&
-                   ((toSq & lineBetween[checkerSq][kingSq]) != BB_NONE);
-        }
-    }
-}
\ No newline at end of file
+    /// Assumes the side to move is in check. Pinned units cannot interpose;
+    /// double checks and contact checks have an empty block mask.
+    return ((fromSq & ctx.bbPinned) == BB_NONE) &&
+           ((toSq & ctx.bbBlock) != BB_NONE);
+}
@@ -8,42 +8,103 @@
 
 class Position;
 
-class AtomicMoveRules : public IMoveRules {
+class AtomicMoveRules final : public IMoveRules {
     // Knowledge of the rules of atomic chess.
     public:
     AtomicMoveRules() = default;
     
     bool isLegal(Move mv, Position& pos) override;
     bool isInCheck(Colour co, const Position& pos) override;
-    Movelist generateLegalMoves(Position& pos) override;
+    Movelist& generateLegalMoves(Movelist& mvlist, Position& pos) override;
+    Movelist& generateLegalMoves(Movelist& mvlist, Position& pos,
+                                 GenType type) override;
+    Movelist& generateLegalMovesTo(Movelist& mvlist, Position& pos,
+                                   PieceType pcty, Square toSq) override;
+    bool hasLegalMove(Position& pos) override;
+    // Counting-only pass of the same generator; no Moves are stored.
+    int countLegalMoves(Position& pos) override;
     
     bool isLegalNaive(Move mv, Position& pos);
     
     protected:
     bool isAttacked(Square sq, Colour co, const Position& pos) override;
     bool isCheckAttacked(Square sq, Colour co, const Position& pos) override;
+    Bitboard findCheckAttacked(Colour co, const Position& pos) override;
     
     protected:
     Bitboard attacksTo(Square sq, Colour co, const Position& pos);
+    Bitboard attacksTo(Square sq, Colour co, Bitboard bbAll,
+                       const Position& pos);
     
     private:
-    Movelist generateLegalMovesNaive(Position& pos);
-    
-    Movelist generateLegalMovesByType(Position& pos);
-    Movelist& addLegalKingMoves(Movelist& mvlist, Position& pos);
-    Movelist& addLegalKnightMoves(Movelist& mvlist, Position& pos);
-    Movelist& addLegalSliderMoves(Movelist& mvlist, Position& pos,
-                                  PieceType pcty);
-    Movelist& addLegalPawnMoves(Movelist& mvlist, Position& pos);
-    Movelist& addLegalPawnCaptures(Movelist& mvlist, Position& pos);
-    Movelist& addLegalPawnPushes(Movelist& mvlist, Position& pos);
-    Movelist& addLegalPawnDoublePushes(Movelist& mvlist, Position& pos);
-    
-    bool isCaptureLegal(Square fromSq, Square toSq, const Position& pos);
+    // Legality information about the side to move's king, computed once per
+    // node and shared by all the per-piece generators. Requires both kings.
+    struct LegalityContext {
+        Square kingSq;
+        bool isConnectedKings;
+        // Enemy units attacking the king (real checks only if not connected).
+        Bitboard bbCheckers;
+        Bitboard bbPinned;
+        // Squares where a non-king move blocks the check: between the king
+        // and a single checking slider, else empty.
+        Bitboard bbBlock;
+        // Enemy units that can be legally captured by any unit not standing
+        // on bbXrayLines (the lines from the king to aligned enemy sliders,
+        // which the capturing unit could be uncovering by leaving).
+        Bitboard bbCaptureTargets;
+        Bitboard bbXrayLines;
+        // Destinations wanted by the generation stage (enemy units for
+        // captures, empty squares for quiets).
+        Bitboard bbDest;
+    };
+    LegalityContext findLegalityContext(const Position& pos);
+    Bitboard findLegalCaptures(Square fromSq, Bitboard bbCaptures,
+                               const Position& pos,
+                               const LegalityContext& ctx);
+    
+    Movelist& generateLegalMovesNaive(Movelist& mvlist, Position& pos);
+    
+    // The by-type generator writes to a Movelist or a MoveCounter (MoveSink).
+    template <typename MoveSink>
+    MoveSink& generateLegalMovesByType(MoveSink& mvlist, const Position& pos,
+                                       GenType type);
+    template <typename MoveSink>
+    MoveSink& addLegalEpMoves(MoveSink& mvlist, const Position& pos,
+                              const LegalityContext& ctx);
+    template <typename MoveSink>
+    MoveSink& addLegalCastlingMoves(MoveSink& mvlist, const Position& pos);
+    template <typename MoveSink>
+    MoveSink& addLegalKingMoves(MoveSink& mvlist, const Position& pos,
+                                const LegalityContext& ctx);
+    template <typename MoveSink>
+    MoveSink& addLegalKnightMoves(MoveSink& mvlist, const Position& pos,
+                                  const LegalityContext& ctx);
+    template <typename MoveSink>
+    MoveSink& addLegalSliderMoves(MoveSink& mvlist, const Position& pos,
+                                  const LegalityContext& ctx, PieceType pcty);
+    template <typename MoveSink>
+    MoveSink& addLegalPawnMoves(MoveSink& mvlist, const Position& pos,
+                                const LegalityContext& ctx);
+    template <typename MoveSink>
+    MoveSink& addLegalPawnCaptures(MoveSink& mvlist, const Position& pos,
+                                   const LegalityContext& ctx);
+    template <typename MoveSink>
+    MoveSink& addLegalPawnPushes(MoveSink& mvlist, const Position& pos,
+                                 const LegalityContext& ctx);
+    template <typename MoveSink>
+    MoveSink& addLegalPawnDoublePushes(MoveSink& mvlist, const Position& pos,
+                                       const LegalityContext& ctx);
+    
+    bool isCaptureLegal(Square fromSq, Square toSq, const Position& pos,
+                        const LegalityContext& ctx);
+    bool isEpLegal(Square fromSq, Square toSq, const Position& pos,
+                   const LegalityContext& ctx);
+    bool isCastlingLegal(CastlingRights cr, const Position& pos);
     bool isLegalNonKingNonCapture(Square fromSq, Square toSq,
-                                  const Position& pos);
+                                  const LegalityContext& ctx);
     bool isConnectedKings(const Position& pos);
-    bool isInterpositionLegal(Square fromSq, Square toSq, const Position& pos);
+    bool isInterpositionLegal(Square fromSq, Square toSq,
+                              const LegalityContext& ctx);
 };
 
 #endif //#ifndef ATOMIC_MOVE_RULES_INCLUDED
\ No newline at end of file
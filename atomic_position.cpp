@@ -6,16 +6,33 @@
 #include "move.h"
 #include "position.h"
 
-#include <array>
 
 void AtomicPosition::makeMove(Move mv) {
+    /// Makes a move, saving the information needed to unmake it.
+    /// Assumes the move is valid (not necessarily legal).
+    
+    // Save irreversible state information in struct, *before* altering them.
+    // Explosion information is written straight into the undo record.
+    StateInfo& undoState {
+        saveState(isCastling(mv) ? NO_PIECE : mailbox[getToSq(mv)])
+    };
+    undoState.movedPiece = mailbox[getFromSq(mv)];
+    applyMove(mv, undoState.explosion);
+    return;
+}
+
+void AtomicPosition::makeMoveNoUndo(Move mv) {
+    /// Makes a move without saving undo information (for copy-make).
+    ExplosionInfo explosion;
+    applyMove(mv, explosion);
+    return;
+}
+
+void AtomicPosition::applyMove(Move mv, ExplosionInfo& explosion) {
     /// Makes a move by changing the state of AtomicPosition.
     /// Assumes the move is valid (not necessarily legal).
     /// Must maintain validity of the Position!
     
-    // Stores explosion information
-    std::array<Bitboard, NUM_COLOURS> explosionByColour {};
-    std::array<Bitboard, NUM_PIECE_TYPES> explosionByType {};
     const Square fromSq {getFromSq(mv)};
     const Square toSq {getToSq(mv)};
     const Piece pc {mailbox[fromSq]};
@@ -23,8 +40,6 @@ void AtomicPosition::makeMove(Move mv) {
     // Castling is handled with parent method (same as orthochess).
     if (isCastling(mv)) {
         makeCastlingMove(mv);
-        // push explosion information for consistency
-        explosionStack.emplace_back(pc, explosionByColour, explosionByType);
         return;
     }
     
@@ -40,38 +55,30 @@ void AtomicPosition::makeMove(Move mv) {
     
     if (isCapture || isEp) {
         // Could be capture, promotion capture, or en passant.
-        // Record, then remove all units exploded.
-        // (Manipulate bitboards directly; mailbox is handled easily later.)
-        for (int i = 1; i < NUM_PIECE_TYPES; ++i) {
-            // Adjacent pawns are *not* exploded (note index of for loop!).
-            explosionByType[i] ^= bbByType[i] & mask;
-            bbByType[i] &= ~explosionByType[i];
+        // Adjacent pawns are *not* exploded, but the captured unit always is
+        // (for en passant, the pawn behind toSq).
+        const Square victimSq {
+            isEp ? ((co == WHITE) ? shiftS(toSq) : shiftN(toSq)) : toSq
+        };
+        const Bitboard bbBlast {((mask & ~bbByType[PAWN]) | victimSq)
+                                & (bbByColour[WHITE] | bbByColour[BLACK])};
+        // Record, then remove all units exploded, a whole bitboard at a time.
+        for (int i = 0; i < NUM_PIECE_TYPES; ++i) {
+            explosion.bbByType[i] = bbByType[i] & bbBlast;
+            bbByType[i] &= ~bbBlast;
         }
         for (int j = 0; j < NUM_COLOURS; ++j) {
-            // Adjacent pawns are *not* exploded.
-            explosionByColour[j] ^= bbByColour[j] & mask & ~bbByType[PAWN];
-            bbByColour[j] &= ~explosionByColour[j];
+            explosion.bbByColour[j] = bbByColour[j] & bbBlast;
+            bbByColour[j] &= ~bbBlast;
         }
-        // But directly captured or en passant'd pawn, *is* exploded.
-        // (For en passant, pcDest will be NO_PIECE!)
-        if (getPieceType(pcDest) == PAWN && pcDest != NO_PIECE) {
-            explosionByColour[!co] ^= toSq;
-            explosionByType[PAWN] ^= toSq;
-            bbByColour[!co] ^= toSq;
-            bbByType[PAWN] ^= toSq;
-        }
-        if (isEp) {
-            Square sqEpCap {(co == WHITE) ? shiftS(toSq) : shiftN(toSq)};
-            explosionByColour[!co] ^= sqEpCap;
-            explosionByType[PAWN] ^= sqEpCap;
-            bbByColour[!co] ^= sqEpCap;
-            bbByType[PAWN] ^= sqEpCap;
-        }
-        // (Now it is convenient to update the mailbox.)
-        Bitboard bbExplosion {explosionByColour[WHITE]
-                              | explosionByColour[BLACK]};
-        while (bbExplosion) {
-            Square sq = popLsb(bbExplosion);
+        // One pass over the blast for the mailbox and key, recording the
+        // pieces in square order.
+        Bitboard bb {bbBlast};
+        for (int k = 0; bb; ++k) {
+            const Square sq {popLsb(bb)};
+            const Piece xpc {mailbox[sq]};
+            explosion.pieces[k] = xpc;
+            key ^= ZOBRIST.pieces[xpc][sq];
             mailbox[sq] = NO_PIECE;
         }
         
@@ -84,9 +91,7 @@ void AtomicPosition::makeMove(Move mv) {
             addPiece(co, pcty, toSq);
         }
     }
-    // Save irreversible state information in struct, *before* altering them.
-    undoStack.emplace_back(pcDest, castlingRights, epRights, fiftyMoveNum);
-    explosionStack.emplace_back(pc, explosionByColour, explosionByType);
+    key ^= stateKey();
     
     // If the enemy king is removed, set variant end flag.
     if (!getUnitsBb(!co, KING)) {
@@ -137,6 +142,7 @@ void AtomicPosition::makeMove(Move mv) {
     }
     // Change side to move, and update fifty-move and halfmove counts.
     sideToMove = !sideToMove;
+    key ^= stateKey();
     if (isCapture || (pcty == PAWN)) {
         fiftyMoveNum = 0;
     } else {
@@ -155,8 +161,6 @@ void AtomicPosition::unmakeMove(Move mv) {
     // Castling is handled with parent method (same as orthochess).
     if (isCastling(mv)) {
         unmakeCastlingMove(mv);
-        // pop explosion stack for consistency
-        explosionStack.pop_back();
         return;
     }
     const Square fromSq {getFromSq(mv)};
@@ -170,10 +174,7 @@ void AtomicPosition::unmakeMove(Move mv) {
         pcty = getPieceType(pc);
     }
     // Grab undo information off the stack. Assumes it matches the move called.
-    StateInfo undoState {undoStack.back()};
-    undoStack.pop_back();
-    ExplosionInfo explosion {explosionStack.back()};
-    explosionStack.pop_back();
+    const StateInfo& undoState {popState()};
     
     // Revert side to move, castling and ep rights, fifty- and half-move counts.
     sideToMove = !sideToMove;
@@ -187,24 +188,18 @@ void AtomicPosition::unmakeMove(Move mv) {
     
     // Restore all captured and exploded units.
     if (isCaptureOrEp) {
-        const std::array<Bitboard, NUM_COLOURS> explosionByColour {
-            explosion.bbExplosionByColour
-        };
-        const std::array<Bitboard, NUM_PIECE_TYPES> explosionByType {
-            explosion.bbExplosionByType
-        };
-        
-        for (int xco = 0; xco < NUM_COLOURS; ++xco) {
-            for (int xpcty = 0; xpcty < NUM_PIECE_TYPES; ++xpcty) {
-                Bitboard bbPiece {explosionByColour[xco]
-                                  & explosionByType[xpcty]};
-                while (bbPiece) {
-                    Square sq {popLsb(bbPiece)};
-                    addPiece(xco, xpcty, sq);
-                }
-            }
+        const ExplosionInfo& explosion {undoState.explosion};
+        for (int i = 0; i < NUM_PIECE_TYPES; ++i) {
+            bbByType[i] |= explosion.bbByType[i];
+        }
+        for (int j = 0; j < NUM_COLOURS; ++j) {
+            bbByColour[j] |= explosion.bbByColour[j];
         }
-        addPiece(explosion.movedPiece, fromSq);
+        Bitboard bb {explosion.bbByColour[WHITE] | explosion.bbByColour[BLACK]};
+        for (int k = 0; bb; ++k) {
+            mailbox[popLsb(bb)] = explosion.pieces[k];
+        }
+        addPiece(undoState.movedPiece, fromSq);
         
     // If not a capture, just put unit back on original square.
     } else if (isPromotion(mv)) {
@@ -214,11 +209,13 @@ void AtomicPosition::unmakeMove(Move mv) {
         addPiece(co, pcty, fromSq);
         removePiece(co, pcty, toSq);
     }
+    // Restore the key last, since moving pieces back also changes it.
+    key = undoState.key;
     return;
 }
 
 void AtomicPosition::reset() {
-    /// Resets AtomicPosition to default. Notably, clears the explosion stack.
+    /// Resets AtomicPosition to default.
     bbByColour.fill(BB_NONE);
     bbByType.fill(BB_NONE);
     mailbox.fill(NO_PIECE);
@@ -227,7 +224,8 @@ void AtomicPosition::reset() {
     epRights = NO_SQ;
     fiftyMoveNum = 0;
     halfmoveNum = 0;
-    undoStack.clear();
-    explosionStack.clear();
+    variantEnd = false;
+    undoPly = 0;
+    key = computeKey();
     return;
 }
\ No newline at end of file
@@ -5,34 +5,25 @@
 #include "move.h"
 #include "position.h"
 
-#include <array>
-#include <deque>
+#include <memory>
 
 /// Position class for atomic chess.
 ///
-class AtomicPosition : public Position {
+class AtomicPosition final : public Position {
     public:
     void makeMove(Move mv) override;
     void unmakeMove(Move mv) override;
+    void makeMoveNoUndo(Move mv) override;
     void reset() override;
+    Variant getVariant() const override {return ATOMIC;}
+    std::unique_ptr<Position> clone() const override {
+        return std::make_unique<AtomicPosition>(*this);
+    }
     
-    protected:
-    struct ExplosionInfo;
-    std::deque<ExplosionInfo> explosionStack {};
-    
-    struct ExplosionInfo {
-        ExplosionInfo(Piece pc,
-                      std::array<Bitboard, NUM_COLOURS> bbExByCo,
-                      std::array<Bitboard, NUM_PIECE_TYPES> bbExByPcty)
-            : movedPiece{pc}
-            , bbExplosionByColour{bbExByCo}
-            , bbExplosionByType{bbExByPcty}
-        { }
-        
-        Piece movedPiece {NO_PIECE};
-        std::array<Bitboard, NUM_COLOURS> bbExplosionByColour {};
-        std::array<Bitboard, NUM_PIECE_TYPES> bbExplosionByType {};
-    };
+    private:
+    // Makes the move, writing the units removed by any explosion to
+    // explosion.
+    void applyMove(Move mv, ExplosionInfo& explosion);
 };
 
 #endif //#ifndef ATOMIC_POSITION_INCLUDED
\ No newline at end of file
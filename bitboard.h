@@ -44,70 +44,72 @@ constexpr std::array<Bitboard, NUM_COLOURS> BB_OUR_4 {BB_4, BB_5};
 constexpr std::array<Bitboard, NUM_COLOURS> BB_OUR_8 {BB_8, BB_1};
 
 // Square-to-Bitboard conversion.
-inline Bitboard bbFromSq(Square sq) {uint64_t x = 1; return (x << sq);}
+constexpr Bitboard bbFromSq(Square sq) {uint64_t x = 1; return (x << sq);}
 
 
 // Bitscan operations -- relies on x64 processor instructions
 #ifdef __GNUC__ // e.g. GCC compiler
 // Clears and returns least significant bit of Bitboard as a Square.
 // Undefined if bitboard is zero.
-inline Square popLsb(Bitboard& bb) {
+constexpr Square popLsb(Bitboard& bb) {
     const Square sq {square(__builtin_ctzll(bb))};
     bb &= bb - 1;
     return sq;
 }
 // Read and return least/greatest significant bits of Bitboard as a Square.
 // Undefined if bitboard is zero.
-inline Square lsb(Bitboard bb) {return square(__builtin_ctzll(bb));}
-inline Square gsb(Bitboard bb) {return square(63 ^ __builtin_clzll(bb));}
+constexpr Square lsb(Bitboard bb) {return square(__builtin_ctzll(bb));}
+constexpr Square gsb(Bitboard bb) {return square(63 ^ __builtin_clzll(bb));}
+// Number of set bits in the Bitboard.
+constexpr int popcount(Bitboard bb) {return __builtin_popcountll(bb);}
 #endif //ifdef GCC compiler
 
 
 // === Bitboard logic ===
-inline Bitboard operator&(Bitboard bb, Square sq) {return bb & bbFromSq(sq);}
-inline Bitboard operator|(Bitboard bb, Square sq) {return bb | bbFromSq(sq);}
-inline Bitboard operator^(Bitboard bb, Square sq) {return bb ^ bbFromSq(sq);}
-inline Bitboard operator&(Square sq, Bitboard bb) {return bb & bbFromSq(sq);}
-inline Bitboard operator|(Square sq, Bitboard bb) {return bb | bbFromSq(sq);}
-inline Bitboard operator^(Square sq, Bitboard bb) {return bb ^ bbFromSq(sq);}
-
-inline Bitboard& operator&=(Bitboard& bb, Square sq) {
+constexpr Bitboard operator&(Bitboard bb, Square sq) {return bb & bbFromSq(sq);}
+constexpr Bitboard operator|(Bitboard bb, Square sq) {return bb | bbFromSq(sq);}
+constexpr Bitboard operator^(Bitboard bb, Square sq) {return bb ^ bbFromSq(sq);}
+constexpr Bitboard operator&(Square sq, Bitboard bb) {return bb & bbFromSq(sq);}
+constexpr Bitboard operator|(Square sq, Bitboard bb) {return bb | bbFromSq(sq);}
+constexpr Bitboard operator^(Square sq, Bitboard bb) {return bb ^ bbFromSq(sq);}
+
+constexpr Bitboard& operator&=(Bitboard& bb, Square sq) {
     return bb &= bbFromSq(sq);
 }
-inline Bitboard& operator|=(Bitboard& bb, Square sq) {
+constexpr Bitboard& operator|=(Bitboard& bb, Square sq) {
     return bb |= bbFromSq(sq);
 }
-inline Bitboard& operator^=(Bitboard& bb, Square sq) {
+constexpr Bitboard& operator^=(Bitboard& bb, Square sq) {
     return bb ^= bbFromSq(sq);
 }
 
-inline Bitboard operator&(Square sq1, Square sq2) {
+constexpr Bitboard operator&(Square sq1, Square sq2) {
     return bbFromSq(sq1) & bbFromSq(sq2);
 }
-inline Bitboard operator|(Square sq1, Square sq2) {
+constexpr Bitboard operator|(Square sq1, Square sq2) {
     return bbFromSq(sq1) | bbFromSq(sq2);
 }
-inline Bitboard operator^(Square sq1, Square sq2) {
+constexpr Bitboard operator^(Square sq1, Square sq2) {
     return bbFromSq(sq1) ^ bbFromSq(sq2);
 }
 
 
 // === Bitboard shifting ===
-inline Bitboard shiftN(Bitboard bb) {return bb << 8;}
-inline Bitboard shiftS(Bitboard bb) {return bb >> 8;}
-inline Bitboard shiftE(Bitboard bb) {return (bb << 1) & ~BB_A;}
-inline Bitboard shiftW(Bitboard bb) {return (bb >> 1) & ~BB_H;}
-inline Bitboard shiftNE(Bitboard bb) {return (bb << 9) & ~BB_A;}
-inline Bitboard shiftNW(Bitboard bb) {return (bb << 7) & ~BB_H;}
-inline Bitboard shiftSE(Bitboard bb) {return (bb >> 7) & ~BB_A;}
-inline Bitboard shiftSW(Bitboard bb) {return (bb >> 9) & ~BB_H;}
-
-inline Bitboard shiftForward(Bitboard bb, Colour co) {
+constexpr Bitboard shiftN(Bitboard bb) {return bb << 8;}
+constexpr Bitboard shiftS(Bitboard bb) {return bb >> 8;}
+constexpr Bitboard shiftE(Bitboard bb) {return (bb << 1) & ~BB_A;}
+constexpr Bitboard shiftW(Bitboard bb) {return (bb >> 1) & ~BB_H;}
+constexpr Bitboard shiftNE(Bitboard bb) {return (bb << 9) & ~BB_A;}
+constexpr Bitboard shiftNW(Bitboard bb) {return (bb << 7) & ~BB_H;}
+constexpr Bitboard shiftSE(Bitboard bb) {return (bb >> 7) & ~BB_A;}
+constexpr Bitboard shiftSW(Bitboard bb) {return (bb >> 9) & ~BB_H;}
+
+constexpr Bitboard shiftForward(Bitboard bb, Colour co) {
     return co == WHITE ? shiftN(bb) : shiftS(bb);
 }
 
 // Test for singly-populated Bitboard
-inline bool isSingle(Bitboard bb) {
+constexpr bool isSingle(Bitboard bb) {
     return bb != BB_NONE && (bb & (bb - 1)) == BB_NONE;
 }
 
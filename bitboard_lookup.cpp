@@ -5,115 +5,9 @@
 
 #include <array>
 
-// Arrays of first-rank/file attacks, for slider move generation.
-// Indexed by the 8 possible slider locations, and 2^(8 - 2) = 64 non-edge
-// occupancy states.
-std::array<std::array<Bitboard, 64>, 8> firstRankAttacks{};
-std::array<std::array<Bitboard, 64>, 8> firstFileAttacks{};
-
-// Defining lookup arrays exposed in .h
-std::array<Bitboard, NUM_SQUARES> knightAttacks{};
-std::array<Bitboard, NUM_SQUARES> kingAttacks{};
-std::array<std::array<Bitboard, NUM_SQUARES>, NUM_COLOURS> pawnAttacks{};
-std::array<Bitboard, NUM_SQUARES> diagMasks{};
-std::array<Bitboard, NUM_SQUARES> antidiagMasks{};
-std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES> lineBetween;
-
-// Declaring auxiliary functions not exposed in .h
-void initialiseAllDiagMasks();
-void initialiseFirstFileAttacks();
-void initialiseFirstRankAttacks();
-void initialiseKingAttacks();
-void initialiseKnightAttacks();
-void initialisePawnAttacks();
-void initialiseLineBetween();
-
-// === Lookup table initialiser ===
-void initialiseBbLookup() {
-    initialiseAllDiagMasks();
-    initialiseFirstRankAttacks();
-    initialiseFirstFileAttacks();
-    initialiseKingAttacks();
-    initialiseKnightAttacks();
-    initialisePawnAttacks();
-    // Must be initialised after rank, file, diag attacks available!
-    initialiseLineBetween();
-    return;
-}
-
-// === Sliding attack getters ===
-// bbPos contains all pieces of position.
-Bitboard findRankAttacks(Square sq, Bitboard bbPos) {
-    int irank {getRankIdx(sq)};
-    int ifile {getFileIdx(sq)};
-    Bitboard oc { bbPos & (BB_1 << (8*irank)) }; // extract just desired rank
-    // b-file multiplication puts desired bits on 8th rank to extract.
-    int ioc { static_cast<int>((oc * BB_B) >> (64 - 6)) };
-    return (BB_1 << (8*irank)) & firstRankAttacks[ifile][ioc];
-}
-
-Bitboard findDiagAttacks(Square sq, Bitboard bbPos) {
-    int ifile {getFileIdx(sq)};
-    Bitboard oc { bbPos & (diagMasks[sq]) }; // extract just desired diagonal
-    // b-file multiplication puts desired bits on 8th rank.
-    int ioc = { static_cast<int>((oc * BB_B) >> (64 - 6)) };
-    return diagMasks[sq] & firstRankAttacks[ifile][ioc];
-}
-
-Bitboard findAntidiagAttacks(Square sq, Bitboard bbPos) {
-    int ifile {getFileIdx(sq)};
-    Bitboard oc { bbPos & (antidiagMasks[sq]) };
-    // b-file multiplication puts desired bits on 8th rank.
-    int ioc = { static_cast<int>((oc * BB_B) >> (64-6)) };
-    return antidiagMasks[sq] & firstRankAttacks[ifile][ioc];
-}
-
-Bitboard findFileAttacks(Square sq, Bitboard bbPos) {
-    int irank {getRankIdx(sq)};
-    int ifile {getFileIdx(sq)};
-    Bitboard oc { (bbPos >> ifile) & BB_A }; // send desired file bits to a-file
-    // multiply by c2-h7 diagonal; flip multiplication extracts lookup index
-    int ioc { static_cast<int>(oc * 0x0080402010080400ULL >> (64-6)) };
-    return firstFileAttacks[irank][ioc] & (BB_A << ifile);
-}
-
-Bitboard findRookAttacks(Square sq, Bitboard bbPos) {
-    return findRankAttacks(sq, bbPos) | findFileAttacks(sq, bbPos);
-}
-
-Bitboard findBishopAttacks(Square sq, Bitboard bbPos) {
-    return findDiagAttacks(sq, bbPos) | findAntidiagAttacks(sq, bbPos);
-}
-
-// === Auxiliary methods ===
-    
-// --- diagonal masks ---
-
-void initialiseAllDiagMasks() {
-    // Generates both diagMasks and antidiagMasks, indexed by Square.
-    // first define the S and W (anti: S and E) edges of the table
-    diagMasks[0] = BB_LONG_DIAG;
-    antidiagMasks[7] = BB_LONG_ANTIDIAG;
-    antidiagMasks[56] = BB_LONG_ANTIDIAG;
-    
-    for (int i = 1; i < 8; ++i) {
-        diagMasks[i] = shiftS(diagMasks[i - 1]);
-        diagMasks[8*i] = shiftN(diagMasks[8*i - 8]);
-        antidiagMasks[7 - i] = shiftS(antidiagMasks[8 - i]);
-        antidiagMasks[7 + 8*i] = shiftN(antidiagMasks[8*i - 1]);
-    }
-    // then propagate and fill in the rest of the table.    
-    for (int x = 1; x < 8; ++x) {
-        for (int y = 1; y < 8; ++y) {
-            diagMasks[x+8*y] = diagMasks[(x-1) + 8*(y-1)];
-            antidiagMasks[7-x+8*y] = antidiagMasks[(8-x) + 8*(y-1)];
-        }
-    }
-    return;
-}
-
 // --- 1st-rank and 1st-file attacks ---
-void initialiseFirstRankAttacks() {
+constexpr std::array<std::array<Bitboard, 64>, 8> generateFirstRankAttacks() {
+    std::array<std::array<Bitboard, 64>, 8> table {};
     for (int ioc = 0; ioc < 64; ++ioc) {
          // +129 sets the end bits of rank to 1 (cannot attack past board edge)
         Bitboard oc = (ioc << 1) + 129;
@@ -137,14 +31,14 @@ void initialiseFirstRankAttacks() {
                            bbFromSq(square(smallLimit)));
             bb ^= r; // slider does not attack itself
             bb *= BB_A; // north-fill multiplication
-            firstRankAttacks[idx_r][ioc] = bb;
+            table[idx_r][ioc] = bb;
         }
     }
-    return;
+    return table;
 }
 
-
-void initialiseFirstFileAttacks() {
+constexpr std::array<std::array<Bitboard, 64>, 8> generateFirstFileAttacks() {
+    std::array<std::array<Bitboard, 64>, 8> table {};
     for (int ioc = 0; ioc < 64; ++ioc) {
         // NOTE: Index 0 here is 8th rank of the real file!
         // In first-rank terms, 1st rank is mapped to h1, 2nd rank to g1, etc.
@@ -177,71 +71,135 @@ void initialiseFirstFileAttacks() {
             bb |= bb >> 1;
             bb |= bb >> 2;
             bb |= bb >> 4;
-            firstFileAttacks[idx_r][ioc] = bb;
+            table[idx_r][ioc] = bb;
         }
     }
-    return;
+    return table;
 }
 
-// --- Simple piece attacks ---
-void initialiseKnightAttacks() {
-    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
-        Bitboard bb {bbFromSq(square(isq))};
-        bb = ( shiftN(shiftNW(bb)) | shiftN(shiftNE(bb)) |
-               shiftE(shiftNE(bb)) | shiftE(shiftSE(bb)) |
-               shiftS(shiftSE(bb)) | shiftS(shiftSW(bb)) |
-               shiftW(shiftSW(bb)) | shiftW(shiftNW(bb)) );
-        knightAttacks[isq] = bb;
+// Arrays of first-rank/file attacks, for slider move generation.
+// Indexed by the 8 possible slider locations, and 2^(8 - 2) = 64 non-edge
+// occupancy states. Generated at compile time.
+constexpr std::array<std::array<Bitboard, 64>, 8> firstRankAttacks {
+    generateFirstRankAttacks()
+};
+constexpr std::array<std::array<Bitboard, 64>, 8> firstFileAttacks {
+    generateFirstFileAttacks()
+};
+
+// --- Magic bitboard attack tables ---
+constexpr std::array<std::array<Bitboard, NUM_SQUARES>, 8> generateRays() {
+    std::array<std::array<Bitboard, NUM_SQUARES>, 8> table {};
+    for (int idir = 0; idir < 8; ++idir) {
+        for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+            table[idir][isq] = findRay(isq, idir);
+        }
     }
-    return;
+    return table;
 }
 
-void initialiseKingAttacks() {
-    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
-        Bitboard bb {bbFromSq(square(isq))};
-        bb = ( shiftN(bb) | shiftNE(bb) | shiftE(bb) | shiftSE(bb) |
-               shiftS(bb) | shiftSW(bb) | shiftW(bb) | shiftNW(bb) );
-        kingAttacks[isq] = bb;
+// Indexed by [direction][square], in RAY_SHIFTS order.
+constexpr std::array<std::array<Bitboard, NUM_SQUARES>, 8> rays {
+    generateRays()
+};
+
+// Squares attacked by a slider on isq along every other direction from
+// firstDir, up to and including the first blocker in bbPos.
+constexpr Bitboard findSlowSliderAttacks(int isq, Bitboard bbPos, int firstDir) {
+    Bitboard bbAttacks {BB_NONE};
+    for (int idir = firstDir; idir < 8; idir += 2) {
+        const std::array<Bitboard, NUM_SQUARES>& dirRays {rays[idir]};
+        const Bitboard bbBlockers {dirRays[isq] & bbPos};
+        bbAttacks |= dirRays[isq];
+        if (bbBlockers) {
+            // The nearest blocker is the lowest one on rays going N, NE, E
+            // or NW, and the highest one on the others.
+            bbAttacks ^= dirRays[(idir <= 2 || idir == 7)
+                                 ? __builtin_ctzll(bbBlockers)
+                                 : 63 ^ __builtin_clzll(bbBlockers)];
+        }
     }
-    return;
+    return bbAttacks;
 }
 
-void initialisePawnAttacks() {
-    // Will generate legal moves for illegal pawn positions too (1st/8th rank)
+template <std::size_t N>
+constexpr std::array<Bitboard, N> generateSliderTable(
+        const std::array<Magic, NUM_SQUARES>& magics, int firstDir) {
+    std::array<Bitboard, N> table {};
     for (int isq = 0; isq < NUM_SQUARES; ++isq) {
-        Bitboard bb {bbFromSq(square(isq))};
-        pawnAttacks[WHITE][isq] = shiftNE(bb) | shiftNW(bb);
-        pawnAttacks[BLACK][isq] = shiftSE(bb) | shiftSW(bb);
+        const Magic& m {magics[isq]};
+        // Enumerate all subsets of the mask (Carry-Rippler trick), which
+        // visits them in the order of their PEXT indices.
+        unsigned int i {0};
+        Bitboard bb {BB_NONE};
+        do {
+            const Bitboard bbAttacks {findSlowSliderAttacks(isq, bb, firstDir)};
+#ifdef USE_PEXT
+            const unsigned int idx {m.offset + i};
+#else
+            const unsigned int idx {
+                m.offset + static_cast<unsigned int>((bb * m.magic) >> m.shift)
+            };
+#endif
+            // A slider always attacks some square, so an empty entry is unused.
+            if (table[idx] != BB_NONE && table[idx] != bbAttacks) {
+                throw "magic number maps two occupancies to one index";
+            }
+            table[idx] = bbAttacks;
+            ++i;
+            bb = (bb - m.mask) & m.mask;
+        } while (bb);
     }
-    return;
+    return table;
 }
 
-void initialiseLineBetween() {
-    // Must be intialised after rank, file and diag attacks are ready!
-    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
-        Square sq1 = square(isq);
-        Bitboard bb1 = bbFromSq(sq1);
-        Bitboard bbOrtho {findRookAttacks(sq1, bb1)};
-        Bitboard bbDiag {findBishopAttacks(sq1, bb1)};
-        for (int jsq = 0; jsq <= isq; ++jsq) {
-            Square sq2 = square(jsq);
-            if (sq2 & bbOrtho) {
-                Bitboard bb = bb1 | sq2;
-                Bitboard bbBetween = {findRookAttacks(sq1, bb) &
-                                      findRookAttacks(sq2, bb)};
-                lineBetween[isq][jsq] = bbBetween;
-                lineBetween[jsq][isq] = bbBetween;
-            } else if (sq2 & bbDiag) {
-                Bitboard bb = bb1 | sq2;
-                Bitboard bbBetween = {findBishopAttacks(sq1, bb) &
-                                      findBishopAttacks(sq2, bb)};
-                lineBetween[isq][jsq] = bbBetween;
-                lineBetween[jsq][isq] = bbBetween;
-            } else {
-                lineBetween[isq][jsq] = BB_NONE;
-                lineBetween[jsq][isq] = BB_NONE;
-            }
-        }
-    }
-    return;
+// Defining lookup arrays exposed in .h
+constexpr std::array<Bitboard, 0x19000> rookTable {
+    generateSliderTable<0x19000>(rookMagics, 0)
+};
+constexpr std::array<Bitboard, 0x1480> bishopTable {
+    generateSliderTable<0x1480>(bishopMagics, 1)
+};
+
+static_assert(rookMagics[63].offset + (1u << (64 - rookMagics[63].shift))
+              == rookTable.size());
+static_assert(bishopMagics[63].offset + (1u << (64 - bishopMagics[63].shift))
+              == bishopTable.size());
+
+// === Sliding attack getters ===
+// bbPos contains all pieces of position.
+// These are the "kindergarten" lookups: multiply-shift to extract an occupancy
+// index, then look up a first-rank/file table.
+Bitboard findRankAttacks(Square sq, Bitboard bbPos) {
+    int irank {getRankIdx(sq)};
+    int ifile {getFileIdx(sq)};
+    Bitboard oc { bbPos & (BB_1 << (8*irank)) }; // extract just desired rank
+    // b-file multiplication puts desired bits on 8th rank to extract.
+    int ioc { static_cast<int>((oc * BB_B) >> (64 - 6)) };
+    return (BB_1 << (8*irank)) & firstRankAttacks[ifile][ioc];
+}
+
+Bitboard findDiagAttacks(Square sq, Bitboard bbPos) {
+    int ifile {getFileIdx(sq)};
+    Bitboard oc { bbPos & (diagMasks[sq]) }; // extract just desired diagonal
+    // b-file multiplication puts desired bits on 8th rank.
+    int ioc = { static_cast<int>((oc * BB_B) >> (64 - 6)) };
+    return diagMasks[sq] & firstRankAttacks[ifile][ioc];
+}
+
+Bitboard findAntidiagAttacks(Square sq, Bitboard bbPos) {
+    int ifile {getFileIdx(sq)};
+    Bitboard oc { bbPos & (antidiagMasks[sq]) };
+    // b-file multiplication puts desired bits on 8th rank.
+    int ioc = { static_cast<int>((oc * BB_B) >> (64-6)) };
+    return antidiagMasks[sq] & firstRankAttacks[ifile][ioc];
+}
+
+Bitboard findFileAttacks(Square sq, Bitboard bbPos) {
+    int irank {getRankIdx(sq)};
+    int ifile {getFileIdx(sq)};
+    Bitboard oc { (bbPos >> ifile) & BB_A }; // send desired file bits to a-file
+    // multiply by c2-h7 diagonal; flip multiplication extracts lookup index
+    int ioc { static_cast<int>(oc * 0x0080402010080400ULL >> (64-6)) };
+    return firstFileAttacks[irank][ioc] & (BB_A << ifile);
 }
@@ -6,40 +6,269 @@
 
 #include <array>
 
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
 // === bitboard_lookup.h ===
 // Contains Bitboard lookup tables (for move generation) and functions to
 // generate them.
 // Also contains functions to get slider attacks in particular directions.
-
-// Initialise tables. Must be called at least once before doing any lookup.
-void initialiseBbLookup();
+//
+// Rook and bishop attacks are looked up from "fancy" magic bitboard tables.
+// Building with USE_PEXT defined (and -mbmi2) replaces the magic
+// multiplication with the BMI2 PEXT instruction to compute the table index.
 
 Bitboard findRankAttacks(Square sq, Bitboard bbPos);
 Bitboard findDiagAttacks(Square sq, Bitboard bbPos);
 Bitboard findAntidiagAttacks(Square sq, Bitboard bbPos);
 Bitboard findFileAttacks(Square sq, Bitboard bbPos);
 
-Bitboard findRookAttacks(Square sq, Bitboard bbPos);
-Bitboard findBishopAttacks(Square sq, Bitboard bbPos);
-
 Bitboard aligned(Square sq1, Square sq2, Square sq3);
 
+// === Lookup table generators ===
+// The eight ray directions, ordered so that opposite directions are four
+// apart.
+constexpr std::array<Bitboard (*)(Bitboard), 8> RAY_SHIFTS {
+    shiftN, shiftNE, shiftE, shiftSE, shiftS, shiftSW, shiftW, shiftNW
+};
+
+// Squares from sq (exclusive) to the board edge in one direction.
+constexpr Bitboard findRay(int isq, int idir) {
+    Bitboard bbRay {BB_NONE};
+    Bitboard bb {RAY_SHIFTS[idir](bbFromSq(square(isq)))};
+    for (; bb; bb = RAY_SHIFTS[idir](bb)) {
+        bbRay |= bb;
+    }
+    return bbRay;
+}
+
+constexpr std::array<Bitboard, NUM_SQUARES> generateKnightAttacks() {
+    std::array<Bitboard, NUM_SQUARES> table {};
+    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+        Bitboard bb {bbFromSq(square(isq))};
+        table[isq] = ( shiftN(shiftNW(bb)) | shiftN(shiftNE(bb)) |
+                       shiftE(shiftNE(bb)) | shiftE(shiftSE(bb)) |
+                       shiftS(shiftSE(bb)) | shiftS(shiftSW(bb)) |
+                       shiftW(shiftSW(bb)) | shiftW(shiftNW(bb)) );
+    }
+    return table;
+}
+
+constexpr std::array<Bitboard, NUM_SQUARES> generateKingAttacks() {
+    std::array<Bitboard, NUM_SQUARES> table {};
+    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+        Bitboard bb {bbFromSq(square(isq))};
+        table[isq] = ( shiftN(bb) | shiftNE(bb) | shiftE(bb) | shiftSE(bb) |
+                       shiftS(bb) | shiftSW(bb) | shiftW(bb) | shiftNW(bb) );
+    }
+    return table;
+}
+
+constexpr std::array<std::array<Bitboard, NUM_SQUARES>, NUM_COLOURS>
+generatePawnAttacks() {
+    // Will generate attacks for illegal pawn positions too (1st/8th rank)
+    std::array<std::array<Bitboard, NUM_SQUARES>, NUM_COLOURS> table {};
+    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+        Bitboard bb {bbFromSq(square(isq))};
+        table[WHITE][isq] = shiftNE(bb) | shiftNW(bb);
+        table[BLACK][isq] = shiftSE(bb) | shiftSW(bb);
+    }
+    return table;
+}
+
+// Directions idir and idir + 4 make up the line through the square.
+constexpr std::array<Bitboard, NUM_SQUARES> generateLineMasks(int idir) {
+    std::array<Bitboard, NUM_SQUARES> table {};
+    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+        table[isq] = findRay(isq, idir) | findRay(isq, idir + 4)
+                     | bbFromSq(square(isq));
+    }
+    return table;
+}
+
+constexpr std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES>
+generateLineBetween() {
+    // Walk out from each square, recording the squares passed on the way.
+    std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES> table {};
+    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+        for (int idir = 0; idir < 8; ++idir) {
+            Bitboard bbBetween {BB_NONE};
+            Bitboard bb {RAY_SHIFTS[idir](bbFromSq(square(isq)))};
+            for (; bb; bb = RAY_SHIFTS[idir](bb)) {
+                table[isq][lsb(bb)] = bbBetween;
+                bbBetween |= bb;
+            }
+        }
+    }
+    return table;
+}
+
+constexpr std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES>
+generateLineThrough() {
+    std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES> table {};
+    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+        for (int idir = 0; idir < 8; ++idir) {
+            const Bitboard bbLine {findRay(isq, idir)
+                                   | findRay(isq, (idir + 4) % 8)
+                                   | bbFromSq(square(isq))};
+            Bitboard bb {findRay(isq, idir)};
+            while (bb) {
+                table[isq][popLsb(bb)] = bbLine;
+            }
+        }
+    }
+    return table;
+}
+
 // === Lookup tables ===
-// **Must be generated before doing any lookup!**
+// Generated at compile time, so always ready (and in read-only memory).
 
 // Indexed by square on the chessboard.
-extern std::array<Bitboard, NUM_SQUARES> knightAttacks;
-extern std::array<Bitboard, NUM_SQUARES> kingAttacks;
+inline constexpr std::array<Bitboard, NUM_SQUARES> knightAttacks {
+    generateKnightAttacks()
+};
+inline constexpr std::array<Bitboard, NUM_SQUARES> kingAttacks {
+    generateKingAttacks()
+};
 // Pawn attacks depend on colour.
-extern std::array<std::array<Bitboard, NUM_SQUARES>, NUM_COLOURS> pawnAttacks;
+inline constexpr std::array<std::array<Bitboard, NUM_SQUARES>, NUM_COLOURS>
+pawnAttacks {generatePawnAttacks()};
 
 // Indexed by square on the chessboard. Contains the Bitboard of the
 // corresponding (anti)diagonal passing through that square.
-extern std::array<Bitboard, NUM_SQUARES> diagMasks;
-extern std::array<Bitboard, NUM_SQUARES> antidiagMasks;
+inline constexpr std::array<Bitboard, NUM_SQUARES> diagMasks {
+    generateLineMasks(1)
+};
+inline constexpr std::array<Bitboard, NUM_SQUARES> antidiagMasks {
+    generateLineMasks(3)
+};
 
 // Lookup for bitboard of squares between (exclusive) two endpoint squares.
 // Bitboard is zero if squares are not along the same rank, file, or diagonal.
-extern std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES> lineBetween;
+inline constexpr std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES>
+lineBetween {generateLineBetween()};
+// Lookup for bitboard of the whole line (edge to edge) through two squares,
+// including both squares. Zero if not along the same rank, file, or diagonal.
+inline constexpr std::array<std::array<Bitboard, NUM_SQUARES>, NUM_SQUARES>
+lineThrough {generateLineThrough()};
+
+// Per-square information to look up slider attacks in a single indexed load.
+struct Magic {
+    Bitboard mask {BB_NONE}; // relevant occupancy, excluding board edges
+    Bitboard magic {BB_NONE}; // unused if USE_PEXT
+    unsigned int offset {0}; // start of this square's attack table
+    unsigned int shift {0};
+    
+    unsigned int index(Bitboard bbPos) const {
+#ifdef USE_PEXT
+        return static_cast<unsigned int>(_pext_u64(bbPos, mask));
+#else
+        return static_cast<unsigned int>(((bbPos & mask) * magic) >> shift);
+#endif
+    }
+};
+
+// Magic numbers, one per square, found by a seeded random search (cf.
+// Stockfish). Each maps every relevant occupancy of its square to a table
+// index with 64 - shift bits, without destructive collisions; the tables are
+// checked against them when they are generated.
+constexpr std::array<Bitboard, NUM_SQUARES> ROOK_MAGIC_NUMBERS {
+    0x0A80004000801220ULL, 0x8040004010002008ULL, 0x2080200010008008ULL,
+    0x1100100008210004ULL, 0xC200209084020008ULL, 0x2100010004000208ULL,
+    0x0400081000822421ULL, 0x0200010422048844ULL, 0x0800800080400024ULL,
+    0x0001402000401000ULL, 0x3000801000802001ULL, 0x4400800800100083ULL,
+    0x0904802402480080ULL, 0x4040800400020080ULL, 0x0018808042000100ULL,
+    0x4040800080004100ULL, 0x0040048001458024ULL, 0x00A0004000205000ULL,
+    0x3100808010002000ULL, 0x4825010010000820ULL, 0x5004808008000401ULL,
+    0x2024818004000A00ULL, 0x0005808002000100ULL, 0x2100060004806104ULL,
+    0x0080400880008421ULL, 0x4062220600410280ULL, 0x010A004A00108022ULL,
+    0x0000100080080080ULL, 0x0021000500080010ULL, 0x0044000202001008ULL,
+    0x0000100400080102ULL, 0xC020128200040545ULL, 0x0080002000400040ULL,
+    0x0000804000802004ULL, 0x0000120022004080ULL, 0x010A386103001001ULL,
+    0x9010080080800400ULL, 0x8440020080800400ULL, 0x0004228824001001ULL,
+    0x000000490A000084ULL, 0x0080002000504000ULL, 0x200020005000C000ULL,
+    0x0012088020420010ULL, 0x0010010080080800ULL, 0x0085001008010004ULL,
+    0x0002000204008080ULL, 0x0040413002040008ULL, 0x0000304081020004ULL,
+    0x0080204000800080ULL, 0x3008804000290100ULL, 0x1010100080200080ULL,
+    0x2008100208028080ULL, 0x5000850800910100ULL, 0x8402019004680200ULL,
+    0x0120911028020400ULL, 0x0000008044010200ULL, 0x0020850200244012ULL,
+    0x0020850200244012ULL, 0x0000102001040841ULL, 0x140900040A100021ULL,
+    0x000200282410A102ULL, 0x000200282410A102ULL, 0x000200282410A102ULL,
+    0x4048240043802106ULL
+};
+constexpr std::array<Bitboard, NUM_SQUARES> BISHOP_MAGIC_NUMBERS {
+    0x40106000A1160020ULL, 0x0020010250810120ULL, 0x2010010220280081ULL,
+    0x002806004050C040ULL, 0x0002021018000000ULL, 0x2001112010000400ULL,
+    0x0881010120218080ULL, 0x1030820110010500ULL, 0x0000120222042400ULL,
+    0x2000020404040044ULL, 0x8000480094208000ULL, 0x0003422A02000001ULL,
+    0x000A220210100040ULL, 0x8004820202226000ULL, 0x0018234854100800ULL,
+    0x0100004042101040ULL, 0x0004001004082820ULL, 0x0010000810010048ULL,
+    0x1014004208081300ULL, 0x2080818802044202ULL, 0x0040880C00A00100ULL,
+    0x0080400200522010ULL, 0x0001000188180B04ULL, 0x0080249202020204ULL,
+    0x1004400004100410ULL, 0x00013100A0022206ULL, 0x2148500001040080ULL,
+    0x4241080011004300ULL, 0x4020848004002000ULL, 0x10101380D1004100ULL,
+    0x0008004422020284ULL, 0x01010A1041008080ULL, 0x0808080400082121ULL,
+    0x0808080400082121ULL, 0x0091128200100C00ULL, 0x0202200802010104ULL,
+    0x8C0A020200440085ULL, 0x01A0008080B10040ULL, 0x0889520080122800ULL,
+    0x100902022202010AULL, 0x04081A0816002000ULL, 0x0000681208005000ULL,
+    0x8170840041008802ULL, 0x0A00004200810805ULL, 0x0830404408210100ULL,
+    0x2602208106006102ULL, 0x1048300680802628ULL, 0x2602208106006102ULL,
+    0x0602010120110040ULL, 0x0941010801043000ULL, 0x000040440A210428ULL,
+    0x0008240020880021ULL, 0x0400002012048200ULL, 0x00AC102001210220ULL,
+    0x0220021002009900ULL, 0x84440C080A013080ULL, 0x0001008044200440ULL,
+    0x0004C04410841000ULL, 0x2000500104011130ULL, 0x1A0C010011C20229ULL,
+    0x0044800112202200ULL, 0x0434804908100424ULL, 0x0300404822C08200ULL,
+    0x48081010008A2A80ULL
+};
+
+// Slider rays are every other direction: rooks from N (0), bishops from NE (1).
+constexpr std::array<Magic, NUM_SQUARES> generateMagics(
+        int firstDir, const std::array<Bitboard, NUM_SQUARES>& magicNumbers) {
+    // Each square's attack table directly follows the previous square's.
+    std::array<Magic, NUM_SQUARES> magics {};
+    unsigned int offset {0};
+    for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+        Square sq {square(isq)};
+        Magic& m {magics[isq]};
+        // Pieces on the board edge never block a slider, unless the slider
+        // itself is on that edge.
+        Bitboard edges {((BB_1 | BB_8) & ~(BB_1 << (8*getRankIdx(sq)))) |
+                        ((BB_A | BB_H) & ~(BB_A << getFileIdx(sq)))};
+        for (int idir = firstDir; idir < 8; idir += 2) {
+            m.mask |= findRay(isq, idir);
+        }
+        m.mask &= ~edges;
+        m.magic = magicNumbers[isq];
+        m.shift = 64 - popcount(m.mask);
+        m.offset = offset;
+        offset += 1u << popcount(m.mask);
+    }
+    return magics;
+}
+
+inline constexpr std::array<Magic, NUM_SQUARES> rookMagics {
+    generateMagics(0, ROOK_MAGIC_NUMBERS)
+};
+inline constexpr std::array<Magic, NUM_SQUARES> bishopMagics {
+    generateMagics(1, BISHOP_MAGIC_NUMBERS)
+};
+
+// Slider attack tables, shared by all squares through the Magic structs.
+// Sizes are the sums over all squares of 2^(number of relevant occupancy bits).
+// Also generated at compile time, but only once, in bitboard_lookup.cpp.
+extern const std::array<Bitboard, 0x19000> rookTable;
+extern const std::array<Bitboard, 0x1480> bishopTable;
+
+// bbPos contains all pieces of position.
+inline Bitboard findRookAttacks(Square sq, Bitboard bbPos) {
+    const Magic& m {rookMagics[sq]};
+    return rookTable[m.offset + m.index(bbPos)];
+}
+
+inline Bitboard findBishopAttacks(Square sq, Bitboard bbPos) {
+    const Magic& m {bishopMagics[sq]};
+    return bishopTable[m.offset + m.index(bbPos)];
+}
 
 #endif //#ifndef BITBOARD_LOOKUP_INCLUDED
\ No newline at end of file
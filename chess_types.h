@@ -4,6 +4,7 @@
 #include <string>
 #include <stdexcept> //helps debugging
 #include <array>
+#include <cstdint>
 
 // === chess_types.h ===
 // Essentially a lot of global constant variables and functions.
@@ -15,6 +16,12 @@
 // Null objects last (unless good reasons), provide a count NUM_[TYPE] outside.
 
 
+// === Variant ===
+// The chess variants known to the program.
+enum Variant : int {ORTHO, ATOMIC};
+constexpr int NUM_VARIANTS {2};
+
+
 // === Colour ===
 // An int representing the colour of the players and units.
 enum Colour : int {WHITE, BLACK, NO_COLOUR};
@@ -50,7 +57,8 @@ inline PieceType pieceType(int i) {
 // An int representing a chess unit with colour and type.
 // Conceptually, the set of valid Pieces should be the Cartesian product of
 // Colour and PieceTypes (except null values).
-enum Piece : int {
+// Stored in a single byte to keep mailboxes compact.
+enum Piece : uint8_t {
     WP, WN, WB, WR, WQ, WK,
     BP, BN, BB, BR, BQ, BK,
     NO_PIECE
@@ -98,12 +106,12 @@ enum Square : int {
 };
 constexpr int NUM_SQUARES {64};
 
-inline Square square(int isq) {
+constexpr Square square(int isq) {
     if (SQ_A1 <= isq && isq <= NO_SQ) {return static_cast<Square>(isq);}
     else {throw std::range_error("Integer not a valid square(int isq).");}
 }
 
-inline Square square(int x, int y) {
+constexpr Square square(int x, int y) {
     //returns validated Square from x/y algebraic coords.
     if ((0 <= x && x <= 7) && (0 <= y && y <= 7)) {
         return static_cast<Square>(x + 8*y);
@@ -113,8 +121,8 @@ inline Square square(int x, int y) {
     }
 }
 
-inline int getRankIdx(Square sq) {return static_cast<int>(sq) >> 3;}
-inline int getFileIdx(Square sq) {return static_cast<int>(sq) & 7;}
+constexpr int getRankIdx(Square sq) {return static_cast<int>(sq) >> 3;}
+constexpr int getFileIdx(Square sq) {return static_cast<int>(sq) & 7;}
 
 inline Square shiftN(Square sq) {return square(static_cast<int>(sq) + 8);}
 inline Square shiftS(Square sq) {return square(static_cast<int>(sq) - 8);}
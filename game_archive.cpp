@@ -0,0 +1,244 @@
+#include "game_archive.h"
+
+#include "chess_types.h"
+#include "move.h"
+#include "move_validator.h"
+#include "position.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr std::string_view ARCHIVE_MAGIC {"BBGA"};
+// Version 2 indexes moves in move generation order (version 1 sorted them).
+// Bump it whenever that order changes, as older indices then mean other moves.
+constexpr char ARCHIVE_VERSION {2};
+constexpr std::size_t ARCHIVE_HEADER_SIZE {5};
+
+// Declaring auxiliary functions not exposed in .h
+bool isLegalPlainMove(Move mv, Position& pos, MoveValidator& validator);
+void writeVarint(std::string& out, std::size_t num);
+bool readVarint(std::string_view data, std::size_t& offset,
+                std::size_t& num);
+
+const char* describeArchiveError(ArchiveError err) {
+    switch (err) {
+        case ARCHIVE_OK: return "no error";
+        case ARCHIVE_END: return "no more games";
+        case ARCHIVE_BAD_HEADER: return "not a game archive";
+        case ARCHIVE_BAD_FEN: return "invalid start FEN";
+        case ARCHIVE_ILLEGAL_MOVE: return "illegal move";
+        case ARCHIVE_TRUNCATED: return "truncated game";
+    }
+    return "unknown error";
+}
+
+GameEncoder::GameEncoder(std::ostream& os, bool isIndexed)
+    : os{os}, isIndexed{isIndexed}
+{
+    os.write(ARCHIVE_MAGIC.data(), ARCHIVE_MAGIC.size());
+    os.put(ARCHIVE_VERSION);
+}
+
+ArchiveError GameEncoder::addGame(Variant var, std::string_view fen,
+                                  const std::vector<Move>& moves) {
+    /// Builds the whole record before writing it, so that a game failing
+    /// halfway leaves no trace in the stream.
+    Position& pos {(var == ATOMIC) ? static_cast<Position&>(atomicPos)
+                                   : static_cast<Position&>(orthoPos)};
+    validator.setVariant(var);
+    if (pos.parseFen(fen.empty() ? START_FEN : fen) != FEN_OK) {
+        return ARCHIVE_BAD_FEN;
+    }
+    uint8_t flags {0};
+    flags |= (var == ATOMIC) ? GAME_ATOMIC : 0;
+    flags |= isIndexed ? GAME_INDEXED : 0;
+    record.assign(1, '\0'); // flags, set below
+    if (!fen.empty()) {
+        // Stored as written back from the position, which is at most
+        // MAX_FEN_LENGTH (so fits its length byte).
+        char buf[Position::MAX_FEN_LENGTH];
+        const std::size_t len {pos.toFen(buf, Position::MAX_FEN_LENGTH)};
+        flags |= GAME_HAS_FEN;
+        record.push_back(static_cast<char>(len));
+        record.append(buf, len);
+    }
+    record[0] = static_cast<char>(flags);
+    writeVarint(record, moves.size());
+    if (isIndexed) {
+        Movelist mvlist {};
+        for (Move mv : moves) {
+            validator.generateLegalMoves(mvlist, pos);
+            const Move* it {std::find(mvlist.begin(), mvlist.end(), mv)};
+            if (it == mvlist.end() || *it != mv) {
+                return ARCHIVE_ILLEGAL_MOVE;
+            }
+            record.push_back(static_cast<char>(it - mvlist.begin()));
+            pos.makeMoveNoUndo(mv);
+        }
+    } else {
+        for (Move mv : moves) {
+            if (!isLegalPlainMove(mv, pos, validator)) {
+                return ARCHIVE_ILLEGAL_MOVE;
+            }
+            record.push_back(static_cast<char>(mv & 0xff));
+            record.push_back(static_cast<char>(mv >> 8));
+            pos.makeMoveNoUndo(mv);
+        }
+    }
+    os.write(record.data(), record.size());
+    return ARCHIVE_OK;
+}
+
+GameDecoder::GameDecoder(std::string_view data)
+    : data{data}
+{
+    if (data.size() < ARCHIVE_HEADER_SIZE
+        || data.substr(0, ARCHIVE_MAGIC.size()) != ARCHIVE_MAGIC
+        || data[ARCHIVE_MAGIC.size()] != ARCHIVE_VERSION) {
+        headerError = ARCHIVE_BAD_HEADER;
+        return;
+    }
+    offset = ARCHIVE_HEADER_SIZE;
+    gameEnd = ARCHIVE_HEADER_SIZE;
+}
+
+ArchiveError GameDecoder::nextGame() {
+    /// Reads the game's header, checking that all of its moves are there.
+    if (headerError != ARCHIVE_OK) {
+        return headerError;
+    }
+    offset = gameEnd;
+    movesLeft = 0;
+    if (offset >= data.size()) {
+        return ARCHIVE_END;
+    }
+    gameOffset = offset;
+    gameId = nextGameId++;
+    // Until the game's length is known, nothing after it can be trusted.
+    gameEnd = data.size();
+    
+    const uint8_t flags {static_cast<uint8_t>(data[offset++])};
+    variant = (flags & GAME_ATOMIC) ? ATOMIC : ORTHO;
+    isIndexed = flags & GAME_INDEXED;
+    validator.setVariant(variant);
+    if (variant == ATOMIC) {
+        pos = &atomicPos;
+    } else {
+        pos = &orthoPos;
+    }
+    std::string_view fen {START_FEN};
+    if (flags & GAME_HAS_FEN) {
+        if (offset >= data.size()
+            || offset + 1 + static_cast<uint8_t>(data[offset]) > data.size()) {
+            return ARCHIVE_TRUNCATED;
+        }
+        const std::size_t len {static_cast<uint8_t>(data[offset++])};
+        fen = data.substr(offset, len);
+        offset += len;
+    }
+    std::size_t numMoves {0};
+    if (!readVarint(data, offset, numMoves)) {
+        return ARCHIVE_TRUNCATED;
+    }
+    const std::size_t moveSize {isIndexed ? 1u : 2u};
+    if (numMoves > (data.size() - offset) / moveSize) {
+        return ARCHIVE_TRUNCATED;
+    }
+    // A bad FEN only spoils this game: the next one starts after its moves.
+    gameEnd = offset + numMoves * moveSize;
+    if (pos->parseFen(fen) != FEN_OK) {
+        return ARCHIVE_BAD_FEN;
+    }
+    movesLeft = numMoves;
+    return ARCHIVE_OK;
+}
+
+ArchiveError GameDecoder::nextMove(Move& mv) {
+    if (movesLeft == 0) {
+        return ARCHIVE_END;
+    }
+    --movesLeft;
+    if (isIndexed) {
+        Movelist mvlist {};
+        validator.generateLegalMoves(mvlist, *pos);
+        const int index {static_cast<uint8_t>(data[offset++])};
+        if (index >= mvlist.size()) {
+            movesLeft = 0;
+            return ARCHIVE_ILLEGAL_MOVE;
+        }
+        mv = mvlist[index];
+    } else {
+        mv = static_cast<Move>(static_cast<uint8_t>(data[offset])
+                               | (static_cast<uint8_t>(data[offset + 1]) << 8));
+        offset += 2;
+        if (!isLegalPlainMove(mv, *pos, validator)) {
+            movesLeft = 0;
+            return ARCHIVE_ILLEGAL_MOVE;
+        }
+    }
+    pos->makeMoveNoUndo(mv);
+    return ARCHIVE_OK;
+}
+
+ArchiveError GameDecoder::readMoves(std::vector<Move>& moves) {
+    moves.clear();
+    Move mv {0};
+    ArchiveError err {ARCHIVE_OK};
+    while ((err = nextMove(mv)) == ARCHIVE_OK) {
+        moves.push_back(mv);
+    }
+    return (err == ARCHIVE_END) ? ARCHIVE_OK : err;
+}
+
+void GameDecoder::seekGame(std::size_t gameStart, std::size_t id) {
+    offset = gameStart;
+    gameEnd = gameStart;
+    movesLeft = 0;
+    nextGameId = id;
+}
+
+
+// === Auxiliary functions ===
+bool isLegalPlainMove(Move mv, Position& pos, MoveValidator& validator) {
+    /// Checks a move read as 16 arbitrary bits against the legal moves of
+    /// the piece on its from-square onto its to-square, so that corrupt data
+    /// is never made.
+    const Piece pc {pos.getMailbox(getFromSq(mv))};
+    if (pc == NO_PIECE || getPieceColour(pc) != pos.getSideToMove()) {
+        return false;
+    }
+    Movelist mvlist {};
+    validator.generateLegalMovesTo(mvlist, pos, getPieceType(pc),
+                                   getToSq(mv));
+    return std::find(mvlist.begin(), mvlist.end(), mv) != mvlist.end();
+}
+
+void writeVarint(std::string& out, std::size_t num) {
+    while (num >= 0x80) {
+        out.push_back(static_cast<char>((num & 0x7f) | 0x80));
+        num >>= 7;
+    }
+    out.push_back(static_cast<char>(num));
+}
+
+bool readVarint(std::string_view data, std::size_t& offset,
+                std::size_t& num) {
+    /// Returns false if the data ends first (or the number overflows).
+    num = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (offset >= data.size()) {
+            return false;
+        }
+        const uint8_t byte {static_cast<uint8_t>(data[offset++])};
+        num |= static_cast<std::size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
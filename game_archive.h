@@ -0,0 +1,124 @@
+#ifndef GAME_ARCHIVE_INCLUDED
+#define GAME_ARCHIVE_INCLUDED
+
+#include "atomic_position.h"
+#include "chess_types.h"
+#include "move.h"
+#include "move_validator.h"
+#include "ortho_position.h"
+#include "position.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// === game_archive.h ===
+// A compact binary container for games, loaded by replaying moves directly
+// instead of parsing SAN.
+//
+// An archive is the 4 bytes "BBGA", a format version byte, then the games
+// back to back. Each game is:
+// - a flags byte: GAME_ATOMIC, GAME_HAS_FEN, GAME_INDEXED,
+// - with GAME_HAS_FEN, a length byte and the start FEN (else the standard
+//   start),
+// - the number of moves, as a LEB128 varint (7 bits per byte, low first),
+// - the moves: each either its 16-bit Move (little-endian), or with
+//   GAME_INDEXED, one byte holding its index among the legal moves in the
+//   order the move generator lists them. (There are never more than 218
+//   legal moves. The indices depend on that order, so the format version
+//   changes with it.)
+//
+// Plain moves are checked, on encoding and decoding, against the legal moves
+// of the moved piece onto its to-square only. Indexed moves are legal by
+// construction, at the cost of generating all the legal moves at every ply,
+// on encoding and decoding. They take half the space, but plain moves load
+// about twice as fast, so plain is the default.
+
+enum GameFlags : uint8_t {
+    GAME_ATOMIC = 1,
+    GAME_HAS_FEN = 2,
+    GAME_INDEXED = 4
+};
+
+enum ArchiveError {
+    ARCHIVE_OK,
+    ARCHIVE_END, // no more games (or moves, for nextMove)
+    ARCHIVE_BAD_HEADER, // not an archive, or an unknown version
+    ARCHIVE_BAD_FEN,
+    ARCHIVE_ILLEGAL_MOVE, // not among the legal moves (or index out of range)
+    ARCHIVE_TRUNCATED // the data ends inside a game
+};
+const char* describeArchiveError(ArchiveError err);
+
+class GameEncoder {
+    /// Writes games to a stream, one record per addGame. The archive header
+    /// is written on construction.
+    public:
+    explicit GameEncoder(std::ostream& os, bool isIndexed = false);
+    
+    // An empty fen means the standard start. Nothing is written on error.
+    ArchiveError addGame(Variant var, std::string_view fen,
+                         const std::vector<Move>& moves);
+    
+    private:
+    std::ostream& os;
+    bool isIndexed;
+    MoveValidator validator;
+    OrthoPosition orthoPos;
+    AtomicPosition atomicPos;
+    // The record being built, reused from game to game.
+    std::string record;
+};
+
+class GameDecoder {
+    /// Reads games out of an archive in memory (e.g. a MappedFile), replaying
+    /// them move by move through a Position of their variant:
+    ///
+    ///     while (decoder.nextGame() == ARCHIVE_OK) {
+    ///         while (decoder.nextMove(mv) == ARCHIVE_OK) {...}
+    ///     }
+    ///
+    /// Moves left unread are skipped by the next nextGame.
+    public:
+    explicit GameDecoder(std::string_view data);
+    
+    // Sets up the start position of the next game.
+    ArchiveError nextGame();
+    // Reads and makes the next move of the game.
+    ArchiveError nextMove(Move& mv);
+    // Reads the rest of the game's moves into moves (cleared first).
+    ArchiveError readMoves(std::vector<Move>& moves);
+    
+    // The current game, during or after its replay.
+    Variant getVariant() const {return variant;}
+    Position& getPosition() {return *pos;}
+    // Number of the current game in the archive, from 0.
+    std::size_t getGameId() const {return gameId;}
+    // Offset of the current game in the data.
+    std::size_t getGameOffset() const {return gameOffset;}
+    // Makes the game at gameStart (from getGameOffset) the next one, and
+    // numbers it id.
+    void seekGame(std::size_t gameStart, std::size_t id);
+    
+    private:
+    std::string_view data;
+    std::size_t offset {0};
+    ArchiveError headerError {ARCHIVE_OK};
+    std::size_t gameId {0};
+    std::size_t nextGameId {0};
+    std::size_t gameOffset {0};
+    bool isIndexed {false};
+    std::size_t movesLeft {0};
+    // The end of the current game's record.
+    std::size_t gameEnd {0};
+    Variant variant {ORTHO};
+    MoveValidator validator;
+    OrthoPosition orthoPos;
+    AtomicPosition atomicPos;
+    Position* pos {&orthoPos};
+};
+
+#endif //#ifndef GAME_ARCHIVE_INCLUDED
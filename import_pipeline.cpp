@@ -0,0 +1,142 @@
+#include "import_pipeline.h"
+
+#include "chess_types.h"
+#include "move.h"
+#include "move_rules.h"
+#include "pgn.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Declaring auxiliary functions not exposed in .h
+void replayGame(GameReplayer& replayer, const PgnGame& game,
+                ImportedGame& imported);
+
+ImportPipeline::ImportPipeline(int numWorkers, Variant defaultVariant)
+    : numWorkers{numWorkers}, defaultVariant{defaultVariant}
+{
+    if (this->numWorkers <= 0) {
+        this->numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+ImportStats ImportPipeline::run(
+        std::string_view text,
+        const std::function<void(const ImportedGame&)>& sink) {
+    /// Batches go round free -> read -> done -> free. Sequence numbers are
+    /// handed out by the reader, and the writer holds back batches finished
+    /// early until those before them are written.
+    const std::size_t poolSize {
+        std::max<std::size_t>(2, batchesPerWorker * numWorkers)
+    };
+    std::vector<Batch> pool(poolSize);
+    // Each queue can hold the whole pool, so only taking a free batch ever
+    // blocks for lack of room.
+    BoundedQueue<Batch*> freeBatches {poolSize};
+    BoundedQueue<Batch*> readBatches {poolSize};
+    BoundedQueue<Batch*> doneBatches {poolSize};
+    for (Batch& batch : pool) {
+        freeBatches.push(&batch);
+    }
+    
+    std::thread reader {[this, text, &freeBatches, &readBatches]() {
+        PgnReader pgnReader {text};
+        PgnGame game;
+        uint64_t seq {0};
+        Batch* batch {nullptr};
+        while (freeBatches.pop(batch)) {
+            batch->seq = seq++;
+            batch->games.clear();
+            while (batch->games.size() < batchSize
+                   && pgnReader.nextGame(game)) {
+                batch->games.push_back(game);
+            }
+            if (batch->games.empty() || !readBatches.push(batch)) {
+                break;
+            }
+        }
+        readBatches.close();
+    }};
+    
+    std::atomic<int> numWorkersLeft {numWorkers};
+    std::vector<std::thread> workers {};
+    for (int t = 0; t < numWorkers; ++t) {
+        workers.emplace_back(
+            [this, &readBatches, &doneBatches, &numWorkersLeft]() {
+                GameReplayer replayer {defaultVariant};
+                Batch* batch {nullptr};
+                while (readBatches.pop(batch)) {
+                    batch->results.resize(batch->games.size());
+                    for (std::size_t i = 0; i < batch->games.size(); ++i) {
+                        replayGame(replayer, batch->games[i],
+                                   batch->results[i]);
+                    }
+                    if (!doneBatches.push(batch)) {
+                        break;
+                    }
+                }
+                if (--numWorkersLeft == 0) {
+                    doneBatches.close();
+                }
+            });
+    }
+    auto joinAll = [&reader, &workers]() {
+        reader.join();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    };
+    
+    // At most poolSize batches are in flight, and their sequence numbers are
+    // consecutive from the next one to write, so each has its own slot.
+    std::vector<Batch*> pending(poolSize, nullptr);
+    uint64_t nextSeq {0};
+    ImportStats stats {};
+    try {
+        Batch* batch {nullptr};
+        while (doneBatches.pop(batch)) {
+            pending[batch->seq % poolSize] = batch;
+            while (pending[nextSeq % poolSize]) {
+                Batch* next {pending[nextSeq % poolSize]};
+                pending[nextSeq % poolSize] = nullptr;
+                for (const ImportedGame& imported : next->results) {
+                    ++stats.numGames;
+                    stats.numErrors += (imported.err != PGN_OK);
+                    stats.numMoves += imported.moves.size();
+                    sink(imported);
+                }
+                ++nextSeq;
+                freeBatches.push(next);
+            }
+        }
+    } catch (...) {
+        freeBatches.close();
+        readBatches.close();
+        doneBatches.close();
+        joinAll();
+        throw;
+    }
+    joinAll();
+    return stats;
+}
+
+
+// === Auxiliary functions ===
+void replayGame(GameReplayer& replayer, const PgnGame& game,
+                ImportedGame& imported) {
+    imported.offset = game.offset;
+    imported.err = replayer.replay(game);
+    imported.variant = replayer.getVariant();
+    imported.fen = replayer.getFen();
+    imported.moves.assign(replayer.getMoves().begin(),
+                          replayer.getMoves().end());
+    imported.result = (imported.err == PGN_OK) ? replayer.getGameResult()
+                                               : NO_RESULT;
+    imported.errorToken = replayer.getErrorToken();
+}
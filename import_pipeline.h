@@ -0,0 +1,130 @@
+#ifndef IMPORT_PIPELINE_INCLUDED
+#define IMPORT_PIPELINE_INCLUDED
+
+#include "chess_types.h"
+#include "move.h"
+#include "move_rules.h"
+#include "pgn.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// === import_pipeline.h ===
+// Imports PGN text on several threads, in three stages:
+// - a reader splits the text into batches of games,
+// - numWorkers workers each replay (validate) their batch's games with their
+//   own GameReplayer, so with their own Positions and MoveValidator,
+// - the writer (the calling thread) hands the results to a sink, in input
+//   order, whatever order the workers finish in.
+//
+// Batches come from a fixed pool and go back to it once written, so at most
+// a pool's worth of games is in flight: the reader blocks when the writer
+// falls behind, and the queues between the stages never grow past the pool.
+// Batches are reused, so a long import does not keep allocating.
+
+template <typename T>
+class BoundedQueue {
+    /// A blocking FIFO queue with a fixed capacity, for passing work between
+    /// threads. Once closed, pushes fail and pops drain what is left.
+    public:
+    explicit BoundedQueue(std::size_t capacity) : capacity{capacity} {}
+    
+    // Blocks while full. Returns false (dropping item) if closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock {mtx};
+        cvNotFull.wait(lock, [this]() {
+            return isClosed || items.size() < capacity;
+        });
+        if (isClosed) {
+            return false;
+        }
+        items.push_back(item);
+        cvNotEmpty.notify_one();
+        return true;
+    }
+    // Blocks while empty. Returns false once closed and empty.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock {mtx};
+        cvNotEmpty.wait(lock, [this]() {
+            return isClosed || !items.empty();
+        });
+        if (items.empty()) {
+            return false;
+        }
+        item = items.front();
+        items.pop_front();
+        cvNotFull.notify_one();
+        return true;
+    }
+    void close() {
+        std::lock_guard<std::mutex> lock {mtx};
+        isClosed = true;
+        cvNotFull.notify_all();
+        cvNotEmpty.notify_all();
+    }
+    
+    private:
+    std::size_t capacity;
+    std::deque<T> items;
+    bool isClosed {false};
+    std::mutex mtx;
+    std::condition_variable cvNotFull;
+    std::condition_variable cvNotEmpty;
+};
+
+// One replayed game. Views point into the imported text.
+struct ImportedGame {
+    std::size_t offset {0}; // of the game in the text
+    PgnError err {PGN_OK};
+    Variant variant {ORTHO};
+    std::string_view fen; // empty for the standard start
+    std::vector<Move> moves; // on error, those before the failing move
+    // Annotation: how the final position ends the game, if it does.
+    GameResult result {NO_RESULT};
+    std::string_view errorToken;
+};
+
+struct ImportStats {
+    uint64_t numGames {0};
+    uint64_t numErrors {0};
+    uint64_t numMoves {0};
+};
+
+class ImportPipeline {
+    public:
+    // numWorkers of 0 for one per hardware thread.
+    explicit ImportPipeline(int numWorkers, Variant defaultVariant = ORTHO);
+    
+    // Games per batch: larger batches mean less locking per game.
+    void setBatchSize(std::size_t size) {batchSize = size;}
+    // Batches in flight per worker.
+    void setBatchesPerWorker(std::size_t num) {batchesPerWorker = num;}
+    int getNumWorkers() const {return numWorkers;}
+    
+    // Imports all games of text, calling sink on each (in order) from the
+    // calling thread. If sink throws, the pipeline is stopped and the
+    // exception passed on.
+    ImportStats run(std::string_view text,
+                    const std::function<void(const ImportedGame&)>& sink);
+    
+    private:
+    struct Batch {
+        uint64_t seq {0};
+        std::vector<PgnGame> games;
+        // Same length as games once replayed; elements are reused.
+        std::vector<ImportedGame> results;
+    };
+    
+    int numWorkers;
+    Variant defaultVariant;
+    std::size_t batchSize {64};
+    std::size_t batchesPerWorker {4};
+};
+
+#endif //#ifndef IMPORT_PIPELINE_INCLUDED
@@ -0,0 +1,62 @@
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path, FileAccess access) {
+#ifdef HAS_MMAP
+    const int fd {open(path.c_str(), O_RDONLY)};
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Cannot stat file " + path);
+    }
+    length = static_cast<std::size_t>(st.st_size);
+    // mmap rejects empty mappings; an empty file is just an empty view.
+    if (length > 0) {
+        void* p {mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0)};
+        if (p == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map file " + path);
+        }
+        madvise(p, length, (access == SEQUENTIAL_ACCESS) ? MADV_SEQUENTIAL
+                                                         : MADV_RANDOM);
+        ptr = static_cast<const char*>(p);
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+#else
+    static_cast<void>(access); // the whole file is read anyway
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        throw std::runtime_error("Cannot open file " + path);
+    }
+    buffer.assign(std::istreambuf_iterator<char>(ifs),
+                  std::istreambuf_iterator<char>());
+    ptr = buffer.data();
+    length = buffer.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef HAS_MMAP
+    if (ptr) {
+        munmap(const_cast<char*>(ptr), length);
+    }
+#endif
+}
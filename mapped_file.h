@@ -0,0 +1,40 @@
+#ifndef MAPPED_FILE_INCLUDED
+#define MAPPED_FILE_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// === mapped_file.h ===
+// A read-only view of a whole file, memory-mapped where the platform allows
+// (POSIX), so that multi-gigabyte inputs are paged in on demand instead of
+// being read into memory up front. Elsewhere, the file is read into a buffer.
+
+// How the file will be read, as a paging hint.
+enum FileAccess {
+    SEQUENTIAL_ACCESS, // front to back: read ahead aggressively
+    RANDOM_ACCESS // scattered lookups: read only the pages touched
+};
+
+class MappedFile {
+    public:
+    // Maps the file. Throws std::runtime_error if it cannot be opened or
+    // mapped.
+    explicit MappedFile(const std::string& path,
+                        FileAccess access = SEQUENTIAL_ACCESS);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const char* data() const {return ptr;}
+    std::size_t size() const {return length;}
+    std::string_view view() const {return std::string_view(ptr, length);}
+    
+    private:
+    const char* ptr {nullptr};
+    std::size_t length {0};
+    // Only used without mmap.
+    std::string buffer;
+};
+
+#endif //#ifndef MAPPED_FILE_INCLUDED
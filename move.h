@@ -3,8 +3,9 @@
 
 #include "chess_types.h"
 
+#include <array>
+#include <cstdint>
 #include <string>
-#include <vector>
 
 // === move.h ===
 // Contains the internal representation of a chess move and associated methods.
@@ -24,7 +25,6 @@
 // the special flag is not set as promotion, then the bits can be repurposed.)
 
 typedef uint16_t Move;
-typedef std::vector<Move> Movelist; // in case needed
 
 // Enum of "special" flags for readability.
 enum MoveSpecial {
@@ -103,4 +103,54 @@ inline std::string toString(Move mv) {
 }
 
 
+// === Movelist ===
+// Fixed-capacity list of Moves, stored inline so that it can live on the stack
+// (no heap allocation). No legal chess position has more than 218 moves, so
+// MAX_MOVES is a safe upper bound. Capacity is not checked on push_back.
+constexpr int MAX_MOVES {256};
+
+class Movelist {
+    public:
+    Movelist() {}
+    
+    void push_back(Move mv) {moves[sz++] = mv;}
+    void clear() {sz = 0;}
+    int size() const {return sz;}
+    bool empty() const {return sz == 0;}
+    
+    Move& operator[](int i) {return moves[i];}
+    Move operator[](int i) const {return moves[i];}
+    
+    Move* begin() {return moves.data();}
+    Move* end() {return moves.data() + sz;}
+    const Move* begin() const {return moves.data();}
+    const Move* end() const {return moves.data() + sz;}
+    
+    Move* erase(Move* it) {
+        /// Removes the Move at it, keeping order. Returns the following element.
+        for (Move* next = it + 1; next != end(); ++next) {
+            *(next - 1) = *next;
+        }
+        --sz;
+        return it;
+    }
+    
+    private:
+    // Deliberately left uninitialised; only the first sz entries are valid.
+    std::array<Move, MAX_MOVES> moves;
+    int sz {0};
+};
+
+// A stand-in for Movelist that only counts the moves pushed to it, for move
+// generators templated on their output (e.g. bulk counting at perft leaves).
+class MoveCounter {
+    public:
+    void push_back(Move) {++sz;}
+    void clear() {sz = 0;}
+    int size() const {return sz;}
+    
+    private:
+    int sz {0};
+};
+
 #endif //#ifndef MOVE_INCLUDED
\ No newline at end of file
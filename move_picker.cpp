@@ -0,0 +1,49 @@
+#include "move_picker.h"
+
+#include "move.h"
+#include "move_rules.h"
+#include "position.h"
+
+
+bool MovePicker::next(Move& mv) {
+    while (idx >= mvlist.size()) {
+        if (stage == DONE) {
+            return false;
+        }
+        advance();
+    }
+    mv = mvlist[idx++];
+    return true;
+}
+
+void MovePicker::advance() {
+    /// Generates the list for the next stage. Whether the side to move is in
+    /// check is found once, at the start: if so, the evasions are all the
+    /// legal moves; if not, all legal moves are either captures or quiets.
+    idx = 0;
+    switch (stage) {
+    case START:
+        if (rules.isInCheck(pos.getSideToMove(), pos)) {
+            stage = DONE;
+            rules.generateEvasions(mvlist, pos);
+            break;
+        }
+        stage = CAPTURE_MOVES;
+        rules.generateCaptures(mvlist, pos);
+        break;
+    case CAPTURE_MOVES:
+        if (isCapturesOnly) {
+            mvlist.clear();
+            stage = DONE;
+            break;
+        }
+        stage = QUIET_MOVES;
+        rules.generateQuiets(mvlist, pos);
+        break;
+    default:
+        mvlist.clear();
+        stage = DONE;
+        break;
+    }
+    return;
+}
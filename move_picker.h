@@ -0,0 +1,41 @@
+#ifndef MOVE_PICKER_INCLUDED
+#define MOVE_PICKER_INCLUDED
+
+#include "move.h"
+#include "move_rules.h"
+
+// === move_picker.h ===
+// Hands out the legal moves of a position one at a time, generating them in
+// stages: if in check, only the evasions; otherwise the captures first, and
+// the quiet moves only once the captures have run out. A caller that stops
+// early (a cutoff) never pays for the later stages.
+
+class Position;
+
+class MovePicker {
+    public:
+    // With isCapturesOnly, the quiet stage is skipped. When in check, though,
+    // every evasion is still given, quiet ones included: a capture-only
+    // search (e.g. quiescence) must not stand pat in check, and needs the
+    // quiet evasions to tell a mate apart.
+    MovePicker(IMoveRules& rules, Position& pos, bool isCapturesOnly = false)
+        : rules(rules), pos(pos), isCapturesOnly(isCapturesOnly) { }
+    
+    // Sets mv to the next legal move and returns true, or returns false once
+    // there are none left. The position must be the same as at construction
+    // whenever next() is called (i.e. unmake a move before asking for more).
+    bool next(Move& mv);
+    
+    private:
+    enum Stage {START, CAPTURE_MOVES, QUIET_MOVES, DONE};
+    IMoveRules& rules;
+    Position& pos;
+    bool isCapturesOnly;
+    Stage stage {START};
+    Movelist mvlist {};
+    int idx {0};
+    
+    void advance();
+};
+
+#endif //#ifndef MOVE_PICKER_INCLUDED
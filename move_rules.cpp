@@ -141,21 +141,6 @@ Movelist& IMoveRules::addEpMoves(Movelist& mvlist, Colour co,
     return mvlist;
 }
 
-Movelist& IMoveRules::addPawnMoves(Movelist& mvlist, Colour co,
-                                   Square fromSq, Square toSq) {
-    /// Helper function to write pawn moves to movelist, given from/to squares.
-    ///
-    if (toSq & BB_OUR_8[co]) {
-        mvlist.push_back(buildPromotion(fromSq, toSq, KNIGHT));
-        mvlist.push_back(buildPromotion(fromSq, toSq, BISHOP));
-        mvlist.push_back(buildPromotion(fromSq, toSq, ROOK));
-        mvlist.push_back(buildPromotion(fromSq, toSq, QUEEN));
-    } else {
-        mvlist.push_back(buildMove(fromSq, toSq));
-    }
-    return mvlist;
-}
-
 bool IMoveRules::isCastlingValid(CastlingRights cr, const Position& pos) {
     /// Helper function to test if a particular castling is valid.
     /// Takes [CastlingRights cr] corresponding to a single castling.
@@ -181,6 +166,9 @@ bool IMoveRules::isCastlingValid(CastlingRights cr, const Position& pos) {
         return false;
     }
     // Test if there are attacked squares in the king's path.
+    if (isUsingAttackMaps) {
+        return !(kingMask & findCheckAttacked(!toColour(cr), pos));
+    }
     Square sq {NO_SQ};
     while (kingMask) {
         sq = popLsb(kingMask);
@@ -220,28 +208,82 @@ Movelist& IMoveRules::addCastlingMoves(Movelist& mvlist, Colour co,
     return mvlist;
 }
 
+GameResult IMoveRules::gameResult(Position& pos) {
+    /// Only positions without a legal move are terminal. In atomic, a side
+    /// whose king has exploded has lost (it is then always its turn).
+    if (!pos.isVariantEnd() && hasLegalMove(pos)) {
+        return NO_RESULT;
+    }
+    const Colour co {pos.getSideToMove()};
+    if (!pos.isVariantEnd() && !isInCheck(co, pos)) {
+        return DRAW; // stalemate
+    }
+    return (co == WHITE) ? BLACK_WINS : WHITE_WINS;
+}
+
+Movelist& IMoveRules::keepChecks(Movelist& mvlist, Position& pos) {
+    /// Filters mvlist down to the moves giving check, by making each one.
+    /// Atomic checks depend on the explosions and on the kings touching, so
+    /// its QUIET_CHECKS stage uses this as a stopgap (orthochess reads checks
+    /// off masks instead). The stage is not performance critical.
+    const Colour co {pos.getSideToMove()};
+    for (auto it = mvlist.begin(); it != mvlist.end();) {
+        pos.makeMove(*it);
+        const bool isCheck {isInCheck(!co, pos)};
+        pos.unmakeMove(*it);
+        if (isCheck) {
+            ++it;
+        } else {
+            it = mvlist.erase(it);
+        }
+    }
+    return mvlist;
+}
+
+Movelist& IMoveRules::removeCastlingNotTo(Movelist& mvlist, Square toSq) {
+    for (auto it = mvlist.begin(); it != mvlist.end();) {
+        if (isCastling(*it) && getToSq(*it) != toSq) {
+            it = mvlist.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return mvlist;
+}
+
 Bitboard IMoveRules::findPinned(Colour co, const Position& pos) {
     /// Returns bitboard of all absolutely pinned pieces of colour co.
     /// Assumes one king and no cannonlike or hopperlike fairy pieces.
+    return findLoneBlockers(co, co, pos);
+}
+
+Bitboard IMoveRules::findDiscoverers(Colour co, const Position& pos) {
+    /// Returns bitboard of the pieces of colour co standing alone between one
+    /// of co's sliders and the enemy king. Assumes as findPinned.
+    return findLoneBlockers(!co, co, pos);
+}
+
+Bitboard IMoveRules::findLoneBlockers(Colour kingCo, Colour co,
+                                      const Position& pos) {
     Bitboard bbAll {pos.getUnitsBb()};
     Bitboard bbFriendly {pos.getUnitsBb(co)};
-    Bitboard bbKing {pos.getUnitsBb(co, KING)};
+    Bitboard bbKing {pos.getUnitsBb(kingCo, KING)};
     Square kingSq {lsb(bbKing)};
     Bitboard bbOrthoPinners {findRookAttacks(kingSq, bbKing)
-                             & (pos.getUnitsBb(!co, ROOK) |
-                                pos.getUnitsBb(!co, QUEEN))};
+                             & (pos.getUnitsBb(!kingCo, ROOK) |
+                                pos.getUnitsBb(!kingCo, QUEEN))};
     Bitboard bbDiagPinners {findBishopAttacks(kingSq, bbKing)
-                            & (pos.getUnitsBb(!co, BISHOP) |
-                               pos.getUnitsBb(!co, QUEEN))};
+                            & (pos.getUnitsBb(!kingCo, BISHOP) |
+                               pos.getUnitsBb(!kingCo, QUEEN))};
     Bitboard bbPinners {bbOrthoPinners | bbDiagPinners};
-    Bitboard bbPinned {BB_NONE};
+    Bitboard bbBlockers {BB_NONE};
     while (bbPinners) {
         Square pinner {popLsb(bbPinners)};
         Bitboard rayPieces {lineBetween[pinner][kingSq] & bbAll};
-        // if ray has one entry which is of colour co, that is a pinned piece.
+        // if ray has one entry which is of colour co, that is a blocker.
         if (isSingle(rayPieces)) {
-            bbPinned |= rayPieces & bbFriendly;
+            bbBlockers |= rayPieces & bbFriendly;
         }
     }
-    return bbPinned;
+    return bbBlockers;
 }
\ No newline at end of file
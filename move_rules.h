@@ -11,6 +11,17 @@
 
 class Position;
 
+// Kinds of legal moves, for staged generation. CAPTURES (including en passant)
+// and QUIETS (everything else, including castling and promotions) partition
+// the legal moves. EVASIONS are all legal moves if in check, else none.
+// QUIET_CHECKS are the quiet moves that give check.
+enum GenType {ALL_MOVES, CAPTURES, QUIETS, EVASIONS, QUIET_CHECKS};
+
+// Outcome of a position as far as the move rules decide it: checkmate,
+// stalemate or a variant end. (Draws by repetition, the fifty-move rule or
+// insufficient material are not considered.)
+enum GameResult {NO_RESULT, WHITE_WINS, BLACK_WINS, DRAW};
+
 class IMoveRules {
     /// An abstract class for the concrete logic-containing rules objects.
     /// These objects will be able to judge move legality of a Position.
@@ -19,7 +30,45 @@ class IMoveRules {
     
     virtual bool isLegal(Move mv, Position& pos) = 0;
     virtual bool isInCheck(Colour co, const Position& pos) = 0;
-    virtual Movelist generateLegalMoves(Position& pos) = 0;
+    // Fills the caller-provided mvlist (cleared first) with all legal moves.
+    virtual Movelist& generateLegalMoves(Movelist& mvlist, Position& pos) = 0;
+    // As above, but only the legal moves of the given kind.
+    virtual Movelist& generateLegalMoves(Movelist& mvlist, Position& pos,
+                                         GenType type) = 0;
+    Movelist& generateCaptures(Movelist& mvlist, Position& pos) {
+        return generateLegalMoves(mvlist, pos, CAPTURES);
+    }
+    Movelist& generateQuiets(Movelist& mvlist, Position& pos) {
+        return generateLegalMoves(mvlist, pos, QUIETS);
+    }
+    Movelist& generateEvasions(Movelist& mvlist, Position& pos) {
+        return generateLegalMoves(mvlist, pos, EVASIONS);
+    }
+    Movelist& generateQuietChecks(Movelist& mvlist, Position& pos) {
+        return generateLegalMoves(mvlist, pos, QUIET_CHECKS);
+    }
+    // Only the legal moves of one piece type onto toSq, e.g. to resolve SAN.
+    // Castling counts as a king move onto the castling rook's square (as in
+    // its Move encoding).
+    virtual Movelist& generateLegalMovesTo(Movelist& mvlist, Position& pos,
+                                           PieceType pcty, Square toSq) = 0;
+    // Number of legal moves. Override where counting is cheaper than listing.
+    virtual int countLegalMoves(Position& pos) {
+        Movelist mvlist {};
+        return generateLegalMoves(mvlist, pos).size();
+    }
+    // Whether the side to move has any legal move. Override to stop at the
+    // first one found.
+    virtual bool hasLegalMove(Position& pos) {
+        return countLegalMoves(pos) > 0;
+    }
+    // NO_RESULT unless the position is terminal.
+    GameResult gameResult(Position& pos);
+    
+    // With attack maps on (the default), "is this square attacked" questions
+    // about the position as-is are answered from the Position's cached attack
+    // maps; off, each square is scanned on demand.
+    void setAttackMaps(bool isOn) {isUsingAttackMaps = isOn;}
     
     protected:
     IMoveRules() {}
@@ -31,6 +80,9 @@ class IMoveRules {
     // Whether an enemy king placed on that square would be in check. (In
     // atomic, this is different from plain attacks!)
     virtual bool isCheckAttacked(Square sq, Colour co, const Position& pos) = 0;
+    // All such squares at once, from the attack maps.
+    virtual Bitboard findCheckAttacked(Colour co, const Position& pos) = 0;
+    bool isUsingAttackMaps {true};
     
     // Code common to most chess variants
     // (Regular) piece moves are independent of variant
@@ -42,9 +94,20 @@ class IMoveRules {
     Movelist& addPawnMoves(Movelist& mvlist, Colour co, const Position& pos);
     Movelist& addEpMoves(Movelist& mvlist, Colour co, const Position& pos);
     
-    // Helper method to write pawn moves to movelist.
-    Movelist& addPawnMoves(Movelist& mvlist, Colour co,
-                           Square fromSq, Square toSq);
+    // Helper method to write pawn moves to movelist (or a MoveCounter).
+    template <typename MoveSink>
+    MoveSink& addPawnMoves(MoveSink& mvlist, Colour co,
+                           Square fromSq, Square toSq) {
+        if (toSq & BB_OUR_8[co]) {
+            mvlist.push_back(buildPromotion(fromSq, toSq, KNIGHT));
+            mvlist.push_back(buildPromotion(fromSq, toSq, BISHOP));
+            mvlist.push_back(buildPromotion(fromSq, toSq, ROOK));
+            mvlist.push_back(buildPromotion(fromSq, toSq, QUEEN));
+        } else {
+            mvlist.push_back(buildMove(fromSq, toSq));
+        }
+        return mvlist;
+    }
     
     // Castling validation needs to know which squares are attacked.
     bool isCastlingValid(CastlingRights cr, const Position& pos);
@@ -53,6 +116,18 @@ class IMoveRules {
     
     // For efficient legal move generation.
     Bitboard findPinned(Colour co, const Position& pos);
+    // Pieces of colour co that, moving off their line, give discovered check.
+    Bitboard findDiscoverers(Colour co, const Position& pos);
+    // Keeps only the (legal) moves that put the opponent in check, by making
+    // each one.
+    Movelist& keepChecks(Movelist& mvlist, Position& pos);
+    // Drops the castling moves whose rook does not stand on toSq.
+    Movelist& removeCastlingNotTo(Movelist& mvlist, Square toSq);
+    
+    private:
+    // Pieces of colour co alone on a line between kingCo's king and an enemy
+    // slider.
+    Bitboard findLoneBlockers(Colour kingCo, Colour co, const Position& pos);
 };
 
 #endif //#I_MOVE_RULES_INCLUDED
\ No newline at end of file
@@ -1,51 +1,100 @@
 #include "move_validator.h"
 
 #include "atomic_move_rules.h"
+#include "atomic_position.h"
 #include "chess_types.h"
 #include "move.h"
 #include "ortho_move_rules.h"
+#include "ortho_position.h"
+#include "perft_table.h"
 #include "position.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <utility>
 #include <vector>
 
 
 void MoveValidator::setVariant(Variant var) {
-    // TODO: avoid wasteful creation/deletion of MoveRules objects
-    // Dependency injection?
-    if (var == ORTHO) {
-        rules.reset(new OrthoMoveRules());
-    } else if (var == ATOMIC) {
-        rules.reset(new AtomicMoveRules());
-    }
     currentVariant = var;
     return;
 }
 
+void MoveValidator::setPerftTable(std::size_t sizeMb,
+                                  ReplacementPolicy policy) {
+    if (sizeMb == 0) {
+        perftTable.reset();
+    } else {
+        perftTable.reset(new PerftTable(sizeMb, policy));
+    }
+    return;
+}
+
 uint64_t MoveValidator::perft(int depth, Position& pos) {
+    /// Counts all legal moves (nodes) at depth n.
+    /// Picks the statically typed implementation matching the variant; a
+    /// Position of another variant falls back to virtual dispatch.
+    const Variant posVariant {pos.getVariant()};
+    if (currentVariant == ORTHO && posVariant == ORTHO) {
+        return perft(orthoRules, depth, static_cast<OrthoPosition&>(pos));
+    } else if (currentVariant == ATOMIC && posVariant == ATOMIC) {
+        return perft(atomicRules, depth, static_cast<AtomicPosition&>(pos));
+    }
+    return perft(getRules(), depth, pos);
+}
+
+template <typename Rules, typename Pos>
+uint64_t MoveValidator::perft(Rules& rules, int depth, Pos& pos) {
     /// Recursive function to count all legal moves (nodes) at depth n.
-    /// 
+    /// With final Rules and Pos types, every call below is direct.
     uint64_t nodes = 0;
     // Terminating condition
     if (depth == 0) {return 1;}
+    if (depth == 1 && isBulkCounting) {
+        return rules.countLegalMoves(pos);
+    }
+    // Depth 1 subtrees are cheaper to count than to look up.
+    const bool isHashed {perftTable && depth > 1};
+    if (isHashed && perftTable->probe(pos.getKey(), depth, nodes)) {
+        return nodes;
+    }
     
-    Movelist mvlist = generateLegalMoves(pos);
+    Movelist mvlist {};
+    rules.generateLegalMoves(mvlist, pos);
     int sz = mvlist.size();
     // Recurse.
-    for (int i = 0; i < sz; ++i) {
-        pos.makeMove(mvlist[i]);
-        int childN = perft(depth-1, pos);
-        nodes += childN;
-        pos.unmakeMove(mvlist[i]);
+    if (perftMode == COPY_MAKE) {
+        const PositionState saved {pos.getState()};
+        for (int i = 0; i < sz; ++i) {
+            pos.makeMoveNoUndo(mvlist[i]);
+            uint64_t childN = perft(rules, depth-1, pos);
+            nodes += childN;
+            pos.setState(saved);
+        }
+    } else {
+        for (int i = 0; i < sz; ++i) {
+            pos.makeMove(mvlist[i]);
+            uint64_t childN = perft(rules, depth-1, pos);
+            nodes += childN;
+            pos.unmakeMove(mvlist[i]);
+        }
+    }
+    if (isHashed) {
+        perftTable->store(pos.getKey(), depth, nodes);
     }
     return nodes;
 }
 
 std::vector<std::pair<Move, uint64_t> > MoveValidator::perftSplit(int depth, Position& pos) {
     uint64_t nodes = 0;
-    Movelist mvlist = generateLegalMoves(pos);
+    Movelist mvlist {};
+    generateLegalMoves(mvlist, pos);
     int sz = mvlist.size();
     std::vector<std::pair<Move, uint64_t> > res {};
     for (int i = 0; i < sz; ++i) {
@@ -58,3 +107,119 @@ std::vector<std::pair<Move, uint64_t> > MoveValidator::perftSplit(int depth, Pos
     return res;
 }
 
+
+
+// === Parallel perft ===
+struct PerftTask {
+    /// A subtree to count: the moves leading to it from the root position.
+    /// path[0] is always the root move the result is credited to.
+    int rootIdx {0};
+    std::array<Move, 2> path {};
+    int pathLen {0};
+};
+
+class PerftTaskQueues {
+    /// One task deque per worker. A worker pops tasks from the back of its own
+    /// deque, and when that runs dry, steals from the front of the others'.
+    public:
+    explicit PerftTaskQueues(int numWorkers) : queues(numWorkers) { }
+    
+    void push(int worker, const PerftTask& task) {
+        std::lock_guard<std::mutex> lock {queues[worker].mtx};
+        queues[worker].tasks.push_back(task);
+        return;
+    }
+    
+    bool pop(int worker, PerftTask& task) {
+        /// Returns false once every queue is empty.
+        const int numQueues {static_cast<int>(queues.size())};
+        {
+            std::lock_guard<std::mutex> lock {queues[worker].mtx};
+            if (!queues[worker].tasks.empty()) {
+                task = queues[worker].tasks.back();
+                queues[worker].tasks.pop_back();
+                return true;
+            }
+        }
+        for (int i = 1; i < numQueues; ++i) {
+            Queue& victim {queues[(worker + i) % numQueues]};
+            std::lock_guard<std::mutex> lock {victim.mtx};
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    private:
+    struct Queue {
+        std::mutex mtx;
+        std::deque<PerftTask> tasks;
+    };
+    std::vector<Queue> queues;
+};
+
+std::vector<std::pair<Move, uint64_t> > MoveValidator::perftSplitParallel(
+    int depth, Position& pos, int numThreads) {
+    /// Splits the tree at the root (and at the replies to each root move, if
+    /// deep enough), hands the subtrees out through work-stealing queues, and
+    /// sums the counts back per root move.
+    if (numThreads <= 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (numThreads == 1 || depth <= 1) {
+        return perftSplit(depth, pos);
+    }
+    Movelist mvlist {};
+    generateLegalMoves(mvlist, pos);
+    const int sz = mvlist.size();
+    
+    // Root moves alone are too few and too uneven to balance many threads, so
+    // split one ply deeper when there is depth to spare.
+    PerftTaskQueues queues {numThreads};
+    int iWorker {0};
+    for (int i = 0; i < sz; ++i) {
+        Move mv = mvlist[i];
+        if (depth < 3) {
+            queues.push(iWorker++ % numThreads, PerftTask{i, {mv, 0}, 1});
+            continue;
+        }
+        Movelist replies {};
+        pos.makeMove(mv);
+        generateLegalMoves(replies, pos);
+        pos.unmakeMove(mv);
+        for (Move reply : replies) {
+            queues.push(iWorker++ % numThreads, PerftTask{i, {mv, reply}, 2});
+        }
+    }
+    
+    std::vector<std::atomic<uint64_t> > counts(sz);
+    std::vector<std::thread> workers {};
+    for (int t = 0; t < numThreads; ++t) {
+        workers.emplace_back([this, t, depth, &pos, &queues, &counts]() {
+            std::unique_ptr<Position> workerPos {pos.clone()};
+            PerftTask task {};
+            while (queues.pop(t, task)) {
+                for (int k = 0; k < task.pathLen; ++k) {
+                    workerPos->makeMove(task.path[k]);
+                }
+                uint64_t nodes {perft(depth - task.pathLen, *workerPos)};
+                for (int k = task.pathLen - 1; k >= 0; --k) {
+                    workerPos->unmakeMove(task.path[k]);
+                }
+                counts[task.rootIdx] += nodes;
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    
+    std::vector<std::pair<Move, uint64_t> > res {};
+    for (int i = 0; i < sz; ++i) {
+        res.emplace_back(std::pair<Move, uint64_t>(mvlist[i], counts[i]));
+    }
+    return res;
+}
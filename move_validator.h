@@ -1,12 +1,18 @@
 #ifndef MOVE_VALIDATOR_INCLUDED
 #define MOVE_VALIDATOR_INCLUDED
 
+#include "atomic_move_rules.h"
 #include "chess_types.h"
 #include "move.h"
+#include "move_picker.h"
 #include "move_rules.h"
+#include "ortho_move_rules.h"
+#include "perft_table.h"
 
 #include <cstdint>
 #include <memory>
+#include <utility>
+#include <vector>
 
 // Contains functions pertaining to move generation from a given position.
 //
@@ -23,13 +29,17 @@
 
 class Position;
 
-enum Variant {
-    ORTHO, ATOMIC
-};
+// How perft walks the tree: make/unmake each move, or save the position state
+// once per node and copy it back after each move (copy-make).
+enum PerftMode {MAKE_UNMAKE, COPY_MAKE};
 
 class MoveValidator {
     /// A class containing methods to validate a move, given a Move and
     /// a Position. Delegates actual checking to member object.
+    ///
+    /// This is a runtime facade: the hot loops (perft) are templates over the
+    /// concrete (final) rules and Position classes, so that inside them no
+    /// call goes through a vtable. The variant is dispatched once per call.
     public:
     MoveValidator() {
         setVariant(ORTHO);
@@ -43,22 +53,82 @@ class MoveValidator {
     Variant getVariant() {return currentVariant;}
     
     bool isLegal(Move mv, Position& pos) {
-        return rules->isLegal(mv, pos);
+        return getRules().isLegal(mv, pos);
     }
     bool isInCheck(Colour co, Position& pos) {
-        return rules->isInCheck(co, pos);
+        return getRules().isInCheck(co, pos);
+    }
+    Movelist& generateLegalMoves(Movelist& mvlist, Position& pos) {
+        return getRules().generateLegalMoves(mvlist, pos);
     }
     Movelist generateLegalMoves(Position& pos) {
-        return rules->generateLegalMoves(pos);
+        Movelist mvlist {};
+        getRules().generateLegalMoves(mvlist, pos);
+        return mvlist;
+    }
+    bool hasLegalMove(Position& pos) {
+        return getRules().hasLegalMove(pos);
+    }
+    GameResult gameResult(Position& pos) {
+        return getRules().gameResult(pos);
+    }
+    // Staged generation: see GenType in move_rules.h.
+    Movelist& generateLegalMoves(Movelist& mvlist, Position& pos,
+                                 GenType type) {
+        return getRules().generateLegalMoves(mvlist, pos, type);
+    }
+    // Legal moves of one piece type onto toSq (see move_rules.h).
+    Movelist& generateLegalMovesTo(Movelist& mvlist, Position& pos,
+                                   PieceType pcty, Square toSq) {
+        return getRules().generateLegalMovesTo(mvlist, pos, pcty, toSq);
+    }
+    // Lazily hands out the legal moves of pos, captures before quiets. The
+    // picker refers to this validator's rules, so must not outlive it.
+    MovePicker getMovePicker(Position& pos, bool isCapturesOnly = false) {
+        return MovePicker(getRules(), pos, isCapturesOnly);
     }
     
     uint64_t perft(int depth, Position& pos);
     std::vector<std::pair<Move, uint64_t> > perftSplit(int depth, Position& pos);
+    // Same result as perftSplit, computed on numThreads worker threads
+    // (0 for one per hardware thread). Each worker uses its own clone of pos.
+    std::vector<std::pair<Move, uint64_t> > perftSplitParallel(
+        int depth, Position& pos, int numThreads);
+    
+    // Hashed perft: while a table is set, perft and perftSplit look up and
+    // store subtree counts in it. A size of 0 MB removes the table.
+    void setPerftTable(std::size_t sizeMb,
+                       ReplacementPolicy policy = REPLACE_DEEPER);
+    PerftTable* getPerftTable() {return perftTable.get();}
+    
+    void setPerftMode(PerftMode mode) {perftMode = mode;}
+    PerftMode getPerftMode() {return perftMode;}
+    // Bulk counting (on by default): depth 1 nodes return the number of legal
+    // moves instead of making each one.
+    void setBulkCounting(bool isOn) {isBulkCounting = isOn;}
+    bool getBulkCounting() {return isBulkCounting;}
+    // Cached attack maps (on by default) versus recomputing attacks on demand.
+    void setAttackMaps(bool isOn) {
+        orthoRules.setAttackMaps(isOn);
+        atomicRules.setAttackMaps(isOn);
+    }
     
     
     protected:
     Variant currentVariant;
-    std::unique_ptr<IMoveRules> rules;
+    // One (stateless) rules object per variant; no allocation on setVariant.
+    OrthoMoveRules orthoRules {};
+    AtomicMoveRules atomicRules {};
+    IMoveRules& getRules() {
+        if (currentVariant == ATOMIC) {return atomicRules;}
+        return orthoRules;
+    }
+    // Statically dispatched perft, instantiated per (rules, position) pair.
+    template <typename Rules, typename Pos>
+    uint64_t perft(Rules& rules, int depth, Pos& pos);
+    std::unique_ptr<PerftTable> perftTable;
+    PerftMode perftMode {MAKE_UNMAKE};
+    bool isBulkCounting {true};
 };
 
 #endif //#ifndef MOVE_VALIDATOR_INCLUDED
\ No newline at end of file
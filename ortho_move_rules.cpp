@@ -6,6 +6,10 @@
 #include "move.h"
 #include "position.h"
 
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+
 
 bool OrthoMoveRules::isInCheck(Colour co, const Position& pos) {
     // Test if a side (colour) is in check.
@@ -17,30 +21,340 @@ bool OrthoMoveRules::isInCheck(Colour co, const Position& pos) {
 
 bool OrthoMoveRules::isLegal(Move mv, Position& pos) {
     /// Test if making a move would leave one's own royalty in check.
-    /// Assumes move is valid.
-    // For eventual speedup logic can be improved from naive make-unmake-make.
-    Colour co {pos.getSideToMove()};
-    pos.makeMove(mv);
-    bool isSuicide {isInCheck(co, pos)};
-    pos.unmakeMove(mv);
-    return !isSuicide;
+    /// Assumes move is valid. Tests the one move against the same masks the
+    /// generator uses (check mask, pin ray, en passant occupancy), so the
+    /// position is never modified.
+    const Colour co {pos.getSideToMove()};
+    const Square fromSq {getFromSq(mv)};
+    const Square toSq {getToSq(mv)};
+    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
+    if (isCastling(mv)) {
+        Movelist mvlist {};
+        if (!isInCheck(co, pos)) {
+            addCastlingMoves(mvlist, co, pos);
+        }
+        return std::find(mvlist.begin(), mvlist.end(), mv) != mvlist.end();
+    }
+    if (fromSq == kingSq) {
+        return !attacksTo(toSq, !co, pos.getUnitsBb() ^ fromSq, pos);
+    }
+    if (isEp(mv)) {
+        const Square capSq {shiftForward(toSq, !co)};
+        const Bitboard bbAll {(pos.getUnitsBb() ^ fromSq ^ capSq) | toSq};
+        return !(attacksTo(kingSq, !co, bbAll, pos) & bbAll);
+    }
+    const Bitboard bbCheckers {attacksTo(kingSq, !co, pos)};
+    if (bbCheckers) {
+        if (!isSingle(bbCheckers)
+            || !(toSq & (bbCheckers | lineBetween[lsb(bbCheckers)][kingSq]))) {
+            return false;
+        }
+    }
+    return !(fromSq & IMoveRules::findPinned(co, pos))
+           || (toSq & lineThrough[kingSq][fromSq]);
 }
 
-Movelist OrthoMoveRules::generateLegalMoves(Position& pos) {
-    Colour co {pos.getSideToMove()};
+Movelist& OrthoMoveRules::generateLegalMoves(Movelist& mvlist, Position& pos) {
+    return generateLegalMoves(mvlist, pos, ALL_MOVES);
+}
+
+Movelist& OrthoMoveRules::generateLegalMoves(Movelist& mvlist, Position& pos,
+                                             GenType type) {
+    /// Directly generates the legal moves of a given kind in the position,
+    /// without making them. Non-king moves must land on the check mask, and
+    /// pinned pieces must stay on their pin ray. King moves and en passant are
+    /// tested separately.
+    const Colour co {pos.getSideToMove()};
+    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
+    const Bitboard bbCheckers {attacksTo(kingSq, !co, pos)};
+    mvlist.clear();
+    if (type == EVASIONS && !bbCheckers) {
+        return mvlist;
+    }
+    if (type == QUIET_CHECKS) {
+        generateLegalMoves(mvlist, pos, QUIETS);
+        return keepQuietChecks(mvlist, pos);
+    }
+    // The kind of move is decided by its destination (except en passant).
+    Bitboard bbDest {BB_ALL};
+    if (type == CAPTURES) {
+        bbDest = pos.getUnitsBb(!co);
+    } else if (type == QUIETS) {
+        bbDest = ~pos.getUnitsBb();
+    }
+    
+    addLegalKingMoves(mvlist, pos, bbCheckers, bbDest);
+    // In double check, only the king can move.
+    if (bbCheckers && !isSingle(bbCheckers)) {
+        return mvlist;
+    }
+    // Either capture the single checker or block it (contact checks cannot be
+    // blocked, but lineBetween is then empty anyway).
+    Bitboard bbTarget {bbDest};
+    if (bbCheckers) {
+        bbTarget &= bbCheckers | lineBetween[lsb(bbCheckers)][kingSq];
+    }
+    const Bitboard bbPinned {IMoveRules::findPinned(co, pos)};
+    addLegalPieceMoves(mvlist, pos, KNIGHT, bbTarget, bbPinned);
+    addLegalPieceMoves(mvlist, pos, BISHOP, bbTarget, bbPinned);
+    addLegalPieceMoves(mvlist, pos, ROOK, bbTarget, bbPinned);
+    addLegalPieceMoves(mvlist, pos, QUEEN, bbTarget, bbPinned);
+    addLegalPawnMoves(mvlist, pos, bbTarget, bbPinned);
+    if (type != QUIETS) {
+        addLegalEpMoves(mvlist, pos);
+    }
+    // Castling validation already requires the king's path to be unattacked.
+    if (!bbCheckers && type != CAPTURES) {
+        addCastlingMoves(mvlist, co, pos);
+    }
+    return mvlist;
+}
+
+Movelist& OrthoMoveRules::generateLegalMovesTo(Movelist& mvlist,
+                                               Position& pos, PieceType pcty,
+                                               Square toSq) {
+    /// As generateLegalMoves, but only runs the generator of pcty, with the
+    /// destinations narrowed down to toSq.
+    const Colour co {pos.getSideToMove()};
+    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
+    const Bitboard bbCheckers {attacksTo(kingSq, !co, pos)};
+    mvlist.clear();
+    if (pcty == KING) {
+        addLegalKingMoves(mvlist, pos, bbCheckers, bbFromSq(toSq));
+        if (!bbCheckers) {
+            addCastlingMoves(mvlist, co, pos);
+            removeCastlingNotTo(mvlist, toSq);
+        }
+        return mvlist;
+    }
+    if (bbCheckers && !isSingle(bbCheckers)) {
+        return mvlist;
+    }
+    Bitboard bbTarget {bbFromSq(toSq)};
+    if (bbCheckers) {
+        bbTarget &= bbCheckers | lineBetween[lsb(bbCheckers)][kingSq];
+    }
+    const Bitboard bbPinned {IMoveRules::findPinned(co, pos)};
+    if (pcty != PAWN) {
+        return addLegalPieceMoves(mvlist, pos, pcty, bbTarget, bbPinned);
+    }
+    addLegalPawnMoves(mvlist, pos, bbTarget, bbPinned);
+    if (toSq == pos.getEpSq()) {
+        addLegalEpMoves(mvlist, pos);
+    }
+    return mvlist;
+}
+
+bool OrthoMoveRules::hasLegalMove(Position& pos) {
+    /// Generates one piece type at a time, stopping at the first that has a
+    /// legal move. The king goes first: it usually can move, and in double
+    /// check nothing else can. Cheap leapers and pawns go before sliders.
+    const Colour co {pos.getSideToMove()};
+    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
+    const Bitboard bbCheckers {attacksTo(kingSq, !co, pos)};
     Movelist mvlist {};
-    // Start generating valid moves.
-    addKingMoves(mvlist, co, pos);
-    addKnightMoves(mvlist, co, pos);
-    addBishopMoves(mvlist, co, pos);
-    addRookMoves(mvlist, co, pos);
-    addQueenMoves(mvlist, co, pos);
-    addPawnMoves(mvlist, co, pos);
-    addEpMoves(mvlist, co, pos);
-    addCastlingMoves(mvlist, co, pos);
-    // Test for checks.
+    if (addLegalKingMoves(mvlist, pos, bbCheckers, BB_ALL).size() > 0) {
+        return true;
+    }
+    if (bbCheckers && !isSingle(bbCheckers)) {
+        return false;
+    }
+    Bitboard bbTarget {BB_ALL};
+    if (bbCheckers) {
+        bbTarget = bbCheckers | lineBetween[lsb(bbCheckers)][kingSq];
+    }
+    const Bitboard bbPinned {IMoveRules::findPinned(co, pos)};
+    if (addLegalPieceMoves(mvlist, pos, KNIGHT, bbTarget, bbPinned).size()
+        || addLegalPawnMoves(mvlist, pos, bbTarget, bbPinned).size()) {
+        return true;
+    }
+    for (PieceType pcty : {BISHOP, ROOK, QUEEN}) {
+        if (addLegalPieceMoves(mvlist, pos, pcty, bbTarget, bbPinned).size()) {
+            return true;
+        }
+    }
+    // Castling is practically never the only legal move, so goes last.
+    return addLegalEpMoves(mvlist, pos).size()
+           || (!bbCheckers && addCastlingMoves(mvlist, co, pos).size());
+}
+
+Movelist& OrthoMoveRules::addLegalKingMoves(Movelist& mvlist,
+                                            const Position& pos,
+                                            Bitboard bbCheckers,
+                                            Bitboard bbDest) {
+    /// Adds king steps to squares not attacked by the enemy. The king itself
+    /// is removed from the occupancy, so it cannot hide behind itself along
+    /// the line of a checking slider.
+    const Colour co {pos.getSideToMove()};
+    const Square fromSq {lsb(pos.getUnitsBb(co, KING))};
+    const Bitboard bbAll {pos.getUnitsBb() ^ fromSq};
+    Bitboard bbTo {kingAttacks[fromSq] & ~pos.getUnitsBb(co) & bbDest};
+    // Out of check, no slider sees through the king, so the attack map of
+    // the position as-is is exact.
+    if (isUsingAttackMaps && !bbCheckers) {
+        bbTo &= ~findCheckAttacked(!co, pos);
+        while (bbTo) {
+            mvlist.push_back(buildMove(fromSq, popLsb(bbTo)));
+        }
+        return mvlist;
+    }
+    while (bbTo) {
+        Square toSq {popLsb(bbTo)};
+        if (!attacksTo(toSq, !co, bbAll, pos)) {
+            mvlist.push_back(buildMove(fromSq, toSq));
+        }
+    }
+    return mvlist;
+}
+
+Movelist& OrthoMoveRules::addLegalPieceMoves(Movelist& mvlist,
+                                             const Position& pos,
+                                             PieceType pcty, Bitboard bbTarget,
+                                             Bitboard bbPinned) {
+    /// Adds legal moves of knights or sliders (bishop, rook, queen).
+    ///
+    const Colour co {pos.getSideToMove()};
+    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
+    bbTarget &= ~pos.getUnitsBb(co);
+    Bitboard bbFrom {pos.getUnitsBb(co, pcty)};
+    while (bbFrom) {
+        Square fromSq {popLsb(bbFrom)};
+        Bitboard bbTo {attacksFrom(fromSq, co, pcty, pos) & bbTarget};
+        // Pinned pieces can only move along the pin ray.
+        if (fromSq & bbPinned) {
+            bbTo &= lineThrough[kingSq][fromSq];
+        }
+        while (bbTo) {
+            mvlist.push_back(buildMove(fromSq, popLsb(bbTo)));
+        }
+    }
+    return mvlist;
+}
+
+Movelist& OrthoMoveRules::addLegalPawnMoves(Movelist& mvlist,
+                                            const Position& pos,
+                                            Bitboard bbTarget,
+                                            Bitboard bbPinned) {
+    /// Adds legal pawn pushes, double pushes, captures and promotions. Does not
+    /// generate en passant captures.
+    const Colour co {pos.getSideToMove()};
+    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
+    const Bitboard bbAll {pos.getUnitsBb()};
+    const Bitboard bbEnemy {pos.getUnitsBb(!co)};
+    Bitboard bbFrom {pos.getUnitsBb(co, PAWN)};
+    while (bbFrom) {
+        Square fromSq {popLsb(bbFrom)};
+        Bitboard bbTo {pawnAttacks[co][fromSq] & bbEnemy};
+        const Square pushSq {shiftForward(fromSq, co)};
+        if (!(pushSq & bbAll)) {
+            bbTo |= pushSq;
+            if (fromSq & BB_OUR_2[co]) {
+                const Square doubleSq {shiftForward(pushSq, co)};
+                if (!(doubleSq & bbAll)) {
+                    bbTo |= doubleSq;
+                }
+            }
+        }
+        bbTo &= bbTarget;
+        if (fromSq & bbPinned) {
+            bbTo &= lineThrough[kingSq][fromSq];
+        }
+        while (bbTo) {
+            IMoveRules::addPawnMoves(mvlist, co, fromSq, popLsb(bbTo));
+        }
+    }
+    return mvlist;
+}
+
+Movelist& OrthoMoveRules::addLegalEpMoves(Movelist& mvlist,
+                                          const Position& pos) {
+    /// En passant removes two pawns from the same rank, which can expose the
+    /// king to a slider in ways the pin and check masks do not capture. So the
+    /// occupancy after the capture is tested directly.
+    if (pos.getEpSq() == NO_SQ) {
+        return mvlist;
+    }
+    const Colour co {pos.getSideToMove()};
+    const Square kingSq {lsb(pos.getUnitsBb(co, KING))};
+    const Square toSq {pos.getEpSq()};
+    const Square capSq {shiftForward(toSq, !co)};
+    Bitboard bbFrom {pawnAttacks[!co][toSq] & pos.getUnitsBb(co, PAWN)};
+    while (bbFrom) {
+        Square fromSq {popLsb(bbFrom)};
+        const Bitboard bbAll {(pos.getUnitsBb() ^ fromSq ^ capSq) | toSq};
+        // The captured pawn no longer attacks anything.
+        if (!(attacksTo(kingSq, !co, bbAll, pos) & bbAll)) {
+            mvlist.push_back(buildEp(fromSq, toSq));
+        }
+    }
+    return mvlist;
+}
+
+Movelist& OrthoMoveRules::keepQuietChecks(Movelist& mvlist,
+                                          const Position& pos) {
+    /// A quiet move checks directly if it lands on a square from which its
+    /// piece attacks the enemy king (moving the piece never opens a line to
+    /// the king for itself, or the king would already be in check), or by
+    /// discovery if a lone blocker of one of our sliders leaves the line.
+    /// Promotions and castling change or move the checking piece, so are
+    /// tested on the occupancy after the move.
+    const Colour co {pos.getSideToMove()};
+    const Square enemyKingSq {lsb(pos.getUnitsBb(!co, KING))};
+    const Bitboard bbAll {pos.getUnitsBb()};
+    const Bitboard bbDiscoverers {IMoveRules::findDiscoverers(co, pos)};
+    // Squares from which each piece type checks (none for the king).
+    std::array<Bitboard, NUM_PIECE_TYPES> bbCheckSqs {};
+    bbCheckSqs[PAWN] = pawnAttacks[!co][enemyKingSq];
+    bbCheckSqs[KNIGHT] = knightAttacks[enemyKingSq];
+    bbCheckSqs[BISHOP] = findBishopAttacks(enemyKingSq, bbAll);
+    bbCheckSqs[ROOK] = findRookAttacks(enemyKingSq, bbAll);
+    bbCheckSqs[QUEEN] = bbCheckSqs[BISHOP] | bbCheckSqs[ROOK];
+    
     for (auto it = mvlist.begin(); it != mvlist.end();) {
-        if (isLegal(*it, pos)) {
+        const Move mv {*it};
+        const Square fromSq {getFromSq(mv)};
+        const Square toSq {getToSq(mv)};
+        bool isCheck {false};
+        if (isCastling(mv)) {
+            // The king stands east of the rook in long castling.
+            CastlingRights cr {(fromSq > toSq) ? CASTLE_QUEENSIDE
+                                               : CASTLE_KINGSIDE};
+            cr &= (co == WHITE) ? CASTLE_WHITE : CASTLE_BLACK;
+            const Square kingToSq {SQ_K_TO[toIndex(cr)]};
+            const Square rookToSq {SQ_R_TO[toIndex(cr)]};
+            const Bitboard bbAfter {(bbAll ^ fromSq ^ toSq) | kingToSq
+                                    | rookToSq};
+            const Bitboard bbRooks {(pos.getUnitsBb(co, ROOK) ^ toSq)
+                                    | rookToSq | pos.getUnitsBb(co, QUEEN)};
+            const Bitboard bbBishops {pos.getUnitsBb(co, BISHOP)
+                                      | pos.getUnitsBb(co, QUEEN)};
+            isCheck = (findRookAttacks(enemyKingSq, bbAfter) & bbRooks)
+                      || (findBishopAttacks(enemyKingSq, bbAfter) & bbBishops);
+        } else if ((fromSq & bbDiscoverers)
+                   && !(toSq & lineThrough[enemyKingSq][fromSq])) {
+            isCheck = true;
+        } else if (isPromotion(mv)) {
+            const Bitboard bbAfter {bbAll ^ fromSq};
+            switch (getPromotionType(mv)) {
+            case KNIGHT:
+                isCheck = knightAttacks[toSq] & enemyKingSq;
+                break;
+            case BISHOP:
+                isCheck = findBishopAttacks(toSq, bbAfter) & enemyKingSq;
+                break;
+            case ROOK:
+                isCheck = findRookAttacks(toSq, bbAfter) & enemyKingSq;
+                break;
+            default:
+                isCheck = (findRookAttacks(toSq, bbAfter)
+                           | findBishopAttacks(toSq, bbAfter)) & enemyKingSq;
+                break;
+            }
+        } else {
+            const PieceType pcty {getPieceType(pos.getMailbox(fromSq))};
+            isCheck = toSq & bbCheckSqs[pcty];
+        }
+        if (isCheck) {
             ++it;
         } else {
             it = mvlist.erase(it);
@@ -65,15 +379,13 @@ Bitboard OrthoMoveRules::attacksFrom(Square sq, Colour co, PieceType pcty,
         bbAttacked = knightAttacks[sq];
         break;
     case BISHOP:
-        bbAttacked = findDiagAttacks(sq, bbAll)
-                     | findAntidiagAttacks(sq, bbAll);
+        bbAttacked = findBishopAttacks(sq, bbAll);
         break;
     case ROOK:
-        bbAttacked = findRankAttacks(sq, bbAll) | findFileAttacks(sq, bbAll);
+        bbAttacked = findRookAttacks(sq, bbAll);
         break;
     case QUEEN:
-        bbAttacked = findRankAttacks(sq, bbAll) | findFileAttacks(sq, bbAll) |
-                    findDiagAttacks(sq, bbAll) | findAntidiagAttacks(sq, bbAll);
+        bbAttacked = findRookAttacks(sq, bbAll) | findBishopAttacks(sq, bbAll);
         break;
     case KING:
         bbAttacked = kingAttacks[sq];
@@ -84,16 +396,22 @@ Bitboard OrthoMoveRules::attacksFrom(Square sq, Colour co, PieceType pcty,
 
 Bitboard OrthoMoveRules::attacksTo(Square sq, Colour co, const Position& pos) {
     /// Returns bitboard of units of a given colour that attack a given square.
+    ///
+    return attacksTo(sq, co, pos.getUnitsBb(), pos);
+}
+
+Bitboard OrthoMoveRules::attacksTo(Square sq, Colour co, Bitboard bbAll,
+                                   const Position& pos) {
+    /// Returns bitboard of units of a given colour that attack a given square,
+    /// with sliders blocked by the occupancy bbAll instead of the position's.
     /// In chess, most piece types have the property that: if piece PC is on
     /// square SQ_A attacking SQ_B, then from SQ_B it would attack SQ_A.
     Bitboard bbAttackers {BB_NONE};
     bbAttackers = kingAttacks[sq] & pos.getUnitsBb(co, KING);
     bbAttackers |= knightAttacks[sq] & pos.getUnitsBb(co, KNIGHT);
-    bbAttackers |= (findDiagAttacks(sq, pos.getUnitsBb()) |
-                    findAntidiagAttacks(sq, pos.getUnitsBb()))
+    bbAttackers |= findBishopAttacks(sq, bbAll)
                    & (pos.getUnitsBb(co, BISHOP) | pos.getUnitsBb(co, QUEEN));
-    bbAttackers |= (findRankAttacks(sq, pos.getUnitsBb()) |
-                    findFileAttacks(sq, pos.getUnitsBb()))
+    bbAttackers |= findRookAttacks(sq, bbAll)
                    & (pos.getUnitsBb(co, ROOK) | pos.getUnitsBb(co, QUEEN));
     // But for pawns, a square SQ_A is attacked by a [Colour] pawn on SQ_B,
     // if a [!Colour] pawn on SQ_A would attack SQ_B.
@@ -112,3 +430,9 @@ bool OrthoMoveRules::isCheckAttacked(Square sq, Colour co, const Position& pos)
     ///
     return isAttacked(sq, co, pos);
 }
+
+Bitboard OrthoMoveRules::findCheckAttacked(Colour co, const Position& pos) {
+    /// Returns all squares attacked by co (kings included).
+    ///
+    return pos.getAttacksBb(co) | kingAttacks[lsb(pos.getUnitsBb(co, KING))];
+}
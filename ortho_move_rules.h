@@ -8,22 +8,44 @@
 
 class Position;
 
-class OrthoMoveRules : public IMoveRules { 
+class OrthoMoveRules final : public IMoveRules {
     // Knowledge of the rules of regular chess, or orthochess.
     public:
     OrthoMoveRules() = default;
     
     bool isLegal(Move mv, Position& pos) override;
     bool isInCheck(Colour co, const Position& pos) override;
-    Movelist generateLegalMoves(Position& pos) override;
+    Movelist& generateLegalMoves(Movelist& mvlist, Position& pos) override;
+    Movelist& generateLegalMoves(Movelist& mvlist, Position& pos,
+                                 GenType type) override;
+    Movelist& generateLegalMovesTo(Movelist& mvlist, Position& pos,
+                                   PieceType pcty, Square toSq) override;
+    bool hasLegalMove(Position& pos) override;
     
     protected:
     bool isAttacked(Square sq, Colour co, const Position& pos) override;
     bool isCheckAttacked(Square sq, Colour co, const Position& pos) override;
+    Bitboard findCheckAttacked(Colour co, const Position& pos) override;
     
     Bitboard attacksFrom(Square sq, Colour co, PieceType pcty,
                          const Position& pos);
     Bitboard attacksTo(Square sq, Colour co, const Position& pos);
+    Bitboard attacksTo(Square sq, Colour co, Bitboard bbAll,
+                       const Position& pos);
+    
+    private:
+    // Legal move generation by piece type, given masks computed once per node.
+    // bbTarget holds the squares that resolve any check (all if no check).
+    Movelist& addLegalKingMoves(Movelist& mvlist, const Position& pos,
+                                Bitboard bbCheckers, Bitboard bbDest);
+    Movelist& addLegalPieceMoves(Movelist& mvlist, const Position& pos,
+                                 PieceType pcty, Bitboard bbTarget,
+                                 Bitboard bbPinned);
+    Movelist& addLegalPawnMoves(Movelist& mvlist, const Position& pos,
+                                Bitboard bbTarget, Bitboard bbPinned);
+    Movelist& addLegalEpMoves(Movelist& mvlist, const Position& pos);
+    // Keeps only the (legal, quiet) moves that put the opponent in check.
+    Movelist& keepQuietChecks(Movelist& mvlist, const Position& pos);
 };
 
-#endif //#ifndef ORTHO_MOVE_RULES_INCLUDED
\ No newline at end of file
+#endif //#ifndef ORTHO_MOVE_RULES_INCLUDED
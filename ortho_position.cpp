@@ -6,6 +6,16 @@
 #include "position.h"
 
 void OrthoPosition::makeMove(Move mv) {
+    /// Makes a move, saving the information needed to unmake it.
+    /// Assumes the move is valid (not necessarily legal).
+    
+    // Save irreversible state information in struct, *before* altering them.
+    saveState(isCastling(mv) ? NO_PIECE : mailbox[getToSq(mv)]);
+    makeMoveNoUndo(mv);
+    return;
+}
+
+void OrthoPosition::makeMoveNoUndo(Move mv) {
     /// Makes a move by changing the state of Position.
     /// Assumes the move is valid (not necessarily legal).
     /// Must maintain validity of the Position!
@@ -48,8 +58,7 @@ void OrthoPosition::makeMove(Move mv) {
     } else {
         addPiece(co, pcty, toSq);
     }
-    // Save irreversible state information in struct, *before* altering them.
-    undoStack.emplace_back(pcDest, castlingRights, epRights, fiftyMoveNum);
+    key ^= stateKey();
     
     // Update ep rights.
     if ((pcty == PAWN) && (fromSq & BB_OUR_2[co]) && (toSq & BB_OUR_4[co])) {
@@ -94,6 +103,7 @@ void OrthoPosition::makeMove(Move mv) {
     }
     // Change side to move, and update fifty-move and halfmove counts.
     sideToMove = !sideToMove;
+    key ^= stateKey();
     if (isCapture || (pcty == PAWN)) {
         fiftyMoveNum = 0;
     } else {
@@ -121,8 +131,7 @@ void OrthoPosition::unmakeMove(Move mv) {
     const PieceType pcty {getPieceType(pc)};
     
     // Grab undo information off the stack. Assumes it matches the move called.
-    StateInfo undoState {undoStack.back()};
-    undoStack.pop_back();
+    const StateInfo& undoState {popState()};
     
     // Revert side to move, castling and ep rights, fifty- and half-move counts.
     sideToMove = !sideToMove;
@@ -151,6 +160,8 @@ void OrthoPosition::unmakeMove(Move mv) {
         Square sqEpCap {(co == WHITE) ? shiftS(toSq) : shiftN(toSq)};
         addPiece(!co, PAWN, sqEpCap);
     }
+    // Restore the key last, since moving pieces back also changes it.
+    key = undoState.key;
     return;
 }
 
@@ -165,7 +176,8 @@ void OrthoPosition::reset() {
     epRights = NO_SQ;
     fiftyMoveNum = 0;
     halfmoveNum = 0;
-    undoStack.clear();
+    undoPly = 0;
+    key = computeKey();
     
     return;
 }
\ No newline at end of file
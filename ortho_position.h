@@ -4,11 +4,18 @@
 #include "move.h"
 #include "position.h"
 
-class OrthoPosition : public Position {
+#include <memory>
+
+class OrthoPosition final : public Position {
     public:
     void makeMove(Move mv) override;
     void unmakeMove(Move mv) override;
+    void makeMoveNoUndo(Move mv) override;
     void reset() override;
+    Variant getVariant() const override {return ORTHO;}
+    std::unique_ptr<Position> clone() const override {
+        return std::make_unique<OrthoPosition>(*this);
+    }
 };
 
 #endif //#ifndef ORTHO_POSITION_INCLUDED
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "packed_position.h"
+
+#include "bitboard.h"
+#include "chess_types.h"
+#include "position.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+
+PackedPosition packPosition(const Position& pos) {
+    PackedPosition packed {};
+    Bitboard bb {pos.getUnitsBb()};
+    if (popcount(bb) > MAX_PACKED_UNITS) {
+        throw std::length_error("Too many units to pack the position.");
+    }
+    packed.words[0] = bb;
+    for (int k = 0; bb; ++k) {
+        const Piece pc {pos.getMailbox(popLsb(bb))};
+        packed.words[1 + k / 16] |= uint64_t {pc} << (4 * (k % 16));
+    }
+    packed.words[3] = static_cast<uint64_t>(pos.getSideToMove())
+                      | (static_cast<uint64_t>(pos.getCastlingRights()) << 1)
+                      | (static_cast<uint64_t>(pos.getEpSq()) << 5);
+    return packed;
+}
+
+#if defined(USE_AVX2)
+// The key is loaded once; each candidate then costs one load and one test.
+std::size_t findEqual(const PackedPosition& key,
+                      const PackedPosition* candidates,
+                      std::size_t numCandidates) {
+    const __m256i k {_mm256_load_si256(
+        reinterpret_cast<const __m256i*>(key.words.data()))};
+    for (std::size_t i = 0; i < numCandidates; ++i) {
+        const __m256i diff {_mm256_xor_si256(k, _mm256_load_si256(
+            reinterpret_cast<const __m256i*>(candidates[i].words.data())))};
+        if (_mm256_testz_si256(diff, diff)) {
+            return i;
+        }
+    }
+    return numCandidates;
+}
+
+std::size_t markEqual(const PackedPosition& key,
+                      const PackedPosition* candidates,
+                      std::size_t numCandidates, bool* isEqual) {
+    const __m256i k {_mm256_load_si256(
+        reinterpret_cast<const __m256i*>(key.words.data()))};
+    std::size_t numEqual {0};
+    for (std::size_t i = 0; i < numCandidates; ++i) {
+        const __m256i diff {_mm256_xor_si256(k, _mm256_load_si256(
+            reinterpret_cast<const __m256i*>(candidates[i].words.data())))};
+        isEqual[i] = _mm256_testz_si256(diff, diff);
+        numEqual += isEqual[i];
+    }
+    return numEqual;
+}
+#else
+std::size_t findEqual(const PackedPosition& key,
+                      const PackedPosition* candidates,
+                      std::size_t numCandidates) {
+    for (std::size_t i = 0; i < numCandidates; ++i) {
+        if (candidates[i] == key) {
+            return i;
+        }
+    }
+    return numCandidates;
+}
+
+std::size_t markEqual(const PackedPosition& key,
+                      const PackedPosition* candidates,
+                      std::size_t numCandidates, bool* isEqual) {
+    std::size_t numEqual {0};
+    for (std::size_t i = 0; i < numCandidates; ++i) {
+        isEqual[i] = (candidates[i] == key);
+        numEqual += isEqual[i];
+    }
+    return numEqual;
+}
+#endif
@@ -0,0 +1,74 @@
+#ifndef PACKED_POSITION_INCLUDED
+#define PACKED_POSITION_INCLUDED
+
+#include "position.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(USE_AVX2) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// === packed_position.h ===
+// A compact, fixed-size key for a Position, for deduplicating large numbers
+// of positions. Two packed positions are equal exactly when the Positions are
+// equal under operator== (so the variant is not included).
+//
+// The 32 bytes are four words:
+// - words[0]: occupancy
+// - words[1], words[2]: the piece on each occupied square, one nibble each, in
+//   square order (hence at most MAX_PACKED_UNITS units)
+// - words[3]: side to move, castling rights and en passant square
+//
+// Comparisons take a single 32-byte AVX2 compare when built with USE_AVX2
+// (make AVX2=1), else two 16-byte SSE2 compares where available, else four
+// scalar word compares.
+
+constexpr int MAX_PACKED_UNITS {32};
+
+struct alignas(32) PackedPosition {
+    std::array<uint64_t, 4> words {};
+};
+
+// Throws std::length_error if the position has more than MAX_PACKED_UNITS
+// units (impossible in a legal game).
+PackedPosition packPosition(const Position& pos);
+
+inline bool operator==(const PackedPosition& lhs, const PackedPosition& rhs) {
+#if defined(USE_AVX2)
+    const __m256i a {_mm256_load_si256(
+        reinterpret_cast<const __m256i*>(lhs.words.data()))};
+    const __m256i b {_mm256_load_si256(
+        reinterpret_cast<const __m256i*>(rhs.words.data()))};
+    const __m256i diff {_mm256_xor_si256(a, b)};
+    return _mm256_testz_si256(diff, diff);
+#elif defined(__SSE2__)
+    const __m128i* a {reinterpret_cast<const __m128i*>(lhs.words.data())};
+    const __m128i* b {reinterpret_cast<const __m128i*>(rhs.words.data())};
+    const __m128i eq {_mm_and_si128(
+        _mm_cmpeq_epi8(_mm_load_si128(a), _mm_load_si128(b)),
+        _mm_cmpeq_epi8(_mm_load_si128(a + 1), _mm_load_si128(b + 1)))};
+    return _mm_movemask_epi8(eq) == 0xFFFF;
+#else
+    return ((lhs.words[0] ^ rhs.words[0]) | (lhs.words[1] ^ rhs.words[1]) |
+            (lhs.words[2] ^ rhs.words[2]) | (lhs.words[3] ^ rhs.words[3]))
+           == 0;
+#endif
+}
+inline bool operator!=(const PackedPosition& lhs, const PackedPosition& rhs) {
+    return !(lhs == rhs);
+}
+
+// --- Batch comparison ---
+// Index of the first candidate equal to key, or numCandidates if none.
+std::size_t findEqual(const PackedPosition& key,
+                      const PackedPosition* candidates,
+                      std::size_t numCandidates);
+// Sets isEqual[i] for every candidate, and returns how many are equal.
+std::size_t markEqual(const PackedPosition& key,
+                      const PackedPosition* candidates,
+                      std::size_t numCandidates, bool* isEqual);
+
+#endif //#ifndef PACKED_POSITION_INCLUDED
@@ -0,0 +1,62 @@
+#include "perft_table.h"
+
+#include "zobrist.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+constexpr int DEPTH_SHIFT {56};
+constexpr uint64_t NODES_MASK {(uint64_t{1} << DEPTH_SHIFT) - 1};
+
+PerftTable::PerftTable(std::size_t sizeMb, ReplacementPolicy policy)
+    : policy{policy}
+{
+    std::size_t numEntries {1};
+    const std::size_t maxEntries {sizeMb * 1024 * 1024 / sizeof(Entry)};
+    while (2 * numEntries <= maxEntries) {
+        numEntries *= 2;
+    }
+    table.reset(new Entry[numEntries]);
+    mask = numEntries - 1;
+}
+
+bool PerftTable::probe(Key key, int depth, uint64_t& nodes) {
+    probes.fetch_add(1, std::memory_order_relaxed);
+    const Entry& entry {table[index(key, depth)]};
+    const uint64_t data {entry.data.load(std::memory_order_relaxed)};
+    const uint64_t check {entry.check.load(std::memory_order_relaxed)};
+    if ((check ^ data) == key &&
+        static_cast<int>(data >> DEPTH_SHIFT) == depth) {
+        hits.fetch_add(1, std::memory_order_relaxed);
+        nodes = data & NODES_MASK;
+        return true;
+    }
+    return false;
+}
+
+void PerftTable::store(Key key, int depth, uint64_t nodes) {
+    Entry& entry {table[index(key, depth)]};
+    if (policy == REPLACE_DEEPER) {
+        const uint64_t oldData {entry.data.load(std::memory_order_relaxed)};
+        if (static_cast<int>(oldData >> DEPTH_SHIFT) > depth) {
+            return;
+        }
+    }
+    const uint64_t data {(static_cast<uint64_t>(depth) << DEPTH_SHIFT)
+                         | (nodes & NODES_MASK)};
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+    entry.data.store(data, std::memory_order_relaxed);
+    return;
+}
+
+void PerftTable::clear() {
+    for (std::size_t i = 0; i <= mask; ++i) {
+        table[i].check.store(0, std::memory_order_relaxed);
+        table[i].data.store(0, std::memory_order_relaxed);
+    }
+    probes = 0;
+    hits = 0;
+    return;
+}
@@ -0,0 +1,69 @@
+#ifndef PERFT_TABLE_INCLUDED
+#define PERFT_TABLE_INCLUDED
+
+#include "zobrist.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// === perft_table.h ===
+// A transposition table for perft, mapping (position key, depth) to the node
+// count of that subtree.
+//
+// Entries store the full 64-bit key and the depth, so a lookup only hits if
+// both match exactly; index collisions cannot return a wrong count. (Two
+// different positions sharing the same 64-bit key is still possible in
+// principle, but vanishingly unlikely.)
+//
+// The table can be shared by several threads without locking: each entry
+// stores its key XORed with its data, so an entry torn by concurrent writes
+// fails the key check and is treated as a miss.
+
+enum ReplacementPolicy {
+    REPLACE_ALWAYS, // newest entry always wins
+    REPLACE_DEEPER  // keep the existing entry if it has a greater depth
+};
+
+class PerftTable {
+    public:
+    // Allocates the largest power-of-two number of entries fitting in sizeMb.
+    PerftTable(std::size_t sizeMb, ReplacementPolicy policy);
+    
+    // Returns true and sets nodes if (key, depth) is in the table.
+    bool probe(Key key, int depth, uint64_t& nodes);
+    void store(Key key, int depth, uint64_t nodes);
+    void clear();
+    
+    std::size_t getNumEntries() const {return mask + 1;}
+    ReplacementPolicy getPolicy() const {return policy;}
+    // Statistics since construction or the last clear().
+    uint64_t getProbes() const {return probes;}
+    uint64_t getHits() const {return hits;}
+    double getHitRate() const {
+        return probes ? static_cast<double>(hits) / probes : 0.0;
+    }
+    
+    private:
+    struct Entry {
+        std::atomic<uint64_t> check {0}; // key ^ data
+        // Node count in the low 56 bits, depth in the high 8 bits.
+        // Depth 0 marks an empty entry; perft never stores depth 0.
+        std::atomic<uint64_t> data {0};
+    };
+    
+    // The depth is mixed into the index so that the same position at
+    // different depths does not compete for one slot.
+    std::size_t index(Key key, int depth) const {
+        return (key ^ (depth * 0x9E3779B97F4A7C15ULL)) & mask;
+    }
+    
+    std::unique_ptr<Entry[]> table;
+    std::size_t mask {0};
+    ReplacementPolicy policy {REPLACE_DEEPER};
+    std::atomic<uint64_t> probes {0};
+    std::atomic<uint64_t> hits {0};
+};
+
+#endif //#ifndef PERFT_TABLE_INCLUDED
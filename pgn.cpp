@@ -0,0 +1,448 @@
+#include "pgn.h"
+
+#include "chess_types.h"
+#include "move.h"
+#include "move_validator.h"
+#include "position.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Declaring auxiliary functions not exposed in .h
+bool isDigit(char c);
+bool isTokenEnd(char c);
+bool isResult(std::string_view token);
+bool isEqualIgnoringCase(std::string_view lhs, std::string_view rhs);
+std::size_t skipVariation(std::string_view text, std::size_t i);
+PieceType pieceTypeFromSan(char c);
+
+const char* describePgnError(PgnError err) {
+    switch (err) {
+        case PGN_OK: return "no error";
+        case PGN_BAD_FEN: return "invalid FEN tag";
+        case PGN_BAD_VARIANT: return "unsupported variant";
+        case PGN_BAD_SAN: return "move is not SAN";
+        case PGN_ILLEGAL_MOVE: return "no legal move matches";
+        case PGN_AMBIGUOUS_MOVE: return "several legal moves match";
+        case PGN_UNTERMINATED: return "unterminated comment or variation";
+    }
+    return "unknown error";
+}
+
+bool PgnReader::nextGame(PgnGame& game) {
+    /// Works a line at a time. Brace comments are tracked, since they may span
+    /// lines and hide a '[' at a line start.
+    const std::size_t size {text.size()};
+    std::size_t i {offset};
+    while (i < size && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r'
+                        || text[i] == '\n')) {
+        ++i;
+    }
+    if (i >= size) {
+        offset = size;
+        return false;
+    }
+    auto nextLine = [this, size](std::size_t lineStart) {
+        const std::size_t eol {text.find('\n', lineStart)};
+        return (eol == std::string_view::npos) ? size : eol + 1;
+    };
+    
+    game.offset = i;
+    const std::size_t tagsStart {i};
+    while (i < size && text[i] == '[') {
+        i = nextLine(i);
+    }
+    game.tags = text.substr(tagsStart, i - tagsStart);
+    
+    const std::size_t movesStart {i};
+    bool isInComment {false};
+    while (i < size && (isInComment || text[i] != '[')) {
+        const std::size_t lineEnd {nextLine(i)};
+        const std::string_view line {text.substr(i, lineEnd - i)};
+        // Jump from brace to brace (a ';' outside braces ends the line).
+        std::size_t j {0};
+        while (true) {
+            if (isInComment) {
+                const std::size_t close {line.find('}', j)};
+                if (close == std::string_view::npos) {
+                    break;
+                }
+                isInComment = false;
+                j = close + 1;
+            } else {
+                const std::size_t open {line.find('{', j)};
+                if (open == std::string_view::npos
+                    || line.substr(j, open - j).find(';')
+                       != std::string_view::npos) {
+                    break;
+                }
+                isInComment = true;
+                j = open + 1;
+            }
+        }
+        i = lineEnd;
+    }
+    game.movetext = text.substr(movesStart, i - movesStart);
+    offset = i;
+    return true;
+}
+
+std::string_view findTag(std::string_view tags, std::string_view name) {
+    /// Tag pairs look like [Name "Value"], one per line.
+    std::size_t i {0};
+    while (i < tags.size()) {
+        std::size_t eol {tags.find('\n', i)};
+        if (eol == std::string_view::npos) {
+            eol = tags.size();
+        }
+        std::string_view line {tags.substr(i, eol - i)};
+        i = eol + 1;
+        if (line.size() < name.size() + 2 || line[0] != '['
+            || line.compare(1, name.size(), name) != 0) {
+            continue;
+        }
+        line.remove_prefix(name.size() + 1);
+        // The name must be followed by a space: "[FEN" is not "[FENx".
+        if (line[0] != ' ' && line[0] != '\t') {
+            continue;
+        }
+        const std::size_t first {line.find('"')};
+        if (first == std::string_view::npos) {
+            return std::string_view {};
+        }
+        std::size_t last {first + 1};
+        while (last < line.size() && line[last] != '"') {
+            last += (line[last] == '\\') ? 2 : 1;
+        }
+        if (last >= line.size()) {
+            return std::string_view {};
+        }
+        return line.substr(first + 1, last - first - 1);
+    }
+    return std::string_view {};
+}
+
+PgnError parseSan(std::string_view san, Position& pos,
+                  MoveValidator& validator, Move& mv) {
+    /// Reads SAN from the back: destination (and promotion) last, then any
+    /// from-file/rank before it, and the piece letter first.
+    /// Long algebraic like "Ng1-f3" is accepted too.
+    while (!san.empty() && (san.back() == '+' || san.back() == '#'
+                            || san.back() == '!' || san.back() == '?')) {
+        san.remove_suffix(1);
+    }
+    const Colour co {pos.getSideToMove()};
+    Movelist mvlist {};
+    
+    // Castling (letter O, or zero as some programs write it).
+    if (san == "O-O" || san == "0-0" || san == "O-O-O" || san == "0-0-0") {
+        const bool isShort {san.size() == 3};
+        const CastlingRights cr {
+            (co == WHITE) ? (isShort ? CASTLE_WSHORT : CASTLE_WLONG)
+                          : (isShort ? CASTLE_BSHORT : CASTLE_BLONG)
+        };
+        validator.generateLegalMovesTo(mvlist, pos, KING,
+                                       pos.getOrigRookSq(cr));
+        for (Move legalMv : mvlist) {
+            if (isCastling(legalMv)) {
+                mv = legalMv;
+                return PGN_OK;
+            }
+        }
+        return PGN_ILLEGAL_MOVE;
+    }
+    
+    PieceType pcty {PAWN};
+    if (!san.empty() && pieceTypeFromSan(san[0]) != NO_PCTY) {
+        pcty = pieceTypeFromSan(san[0]);
+        san.remove_prefix(1);
+    }
+    PieceType pctyPromo {NO_PCTY};
+    if (pcty == PAWN && san.size() >= 3 && pieceTypeFromSan(san.back()) != KING
+        && pieceTypeFromSan(san.back()) != NO_PCTY) {
+        pctyPromo = pieceTypeFromSan(san.back());
+        san.remove_suffix(san[san.size() - 2] == '=' ? 2 : 1);
+    }
+    if (san.size() < 2) {
+        return PGN_BAD_SAN;
+    }
+    const char toFile {san[san.size() - 2]};
+    const char toRank {san[san.size() - 1]};
+    if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8') {
+        return PGN_BAD_SAN;
+    }
+    const Square toSq {square(toFile - 'a', toRank - '1')};
+    san.remove_suffix(2);
+    
+    // Whatever is left may only narrow down the from-square.
+    int fromFile {-1};
+    int fromRank {-1};
+    for (char c : san) {
+        if ('a' <= c && c <= 'h') {
+            fromFile = c - 'a';
+        } else if ('1' <= c && c <= '8') {
+            fromRank = c - '1';
+        } else if (c != 'x' && c != ':' && c != '-') {
+            return PGN_BAD_SAN;
+        }
+    }
+    
+    int numMatches {0};
+    validator.generateLegalMovesTo(mvlist, pos, pcty, toSq);
+    for (Move legalMv : mvlist) {
+        const Square fromSq {getFromSq(legalMv)};
+        if ((fromFile >= 0 && getFileIdx(fromSq) != fromFile)
+            || (fromRank >= 0 && getRankIdx(fromSq) != fromRank)
+            || isCastling(legalMv)) {
+            continue;
+        }
+        if (isPromotion(legalMv) ? (getPromotionType(legalMv) != pctyPromo)
+                                 : (pctyPromo != NO_PCTY)) {
+            continue;
+        }
+        mv = legalMv;
+        ++numMatches;
+    }
+    if (numMatches == 0) {
+        return PGN_ILLEGAL_MOVE;
+    }
+    return (numMatches == 1) ? PGN_OK : PGN_AMBIGUOUS_MOVE;
+}
+
+std::string toSan(Move mv, Position& pos, MoveValidator& validator) {
+    /// Pieces are disambiguated by file if that suffices, else by rank, else
+    /// by both.
+    const Square fromSq {getFromSq(mv)};
+    const Square toSq {getToSq(mv)};
+    std::string san;
+    if (isCastling(mv)) {
+        san = (getFileIdx(toSq) > getFileIdx(fromSq)) ? "O-O" : "O-O-O";
+    } else {
+        const PieceType pcty {getPieceType(pos.getMailbox(fromSq))};
+        const bool isCapture {pos.getMailbox(toSq) != NO_PIECE || isEp(mv)};
+        if (pcty == PAWN) {
+            if (isCapture) {
+                san.push_back('a' + getFileIdx(fromSq));
+            }
+        } else {
+            san.push_back(PIECE_CHARS[pcty]);
+            Movelist mvlist {};
+            validator.generateLegalMovesTo(mvlist, pos, pcty, toSq);
+            bool isAmbiguous {false};
+            bool isFileShared {false};
+            bool isRankShared {false};
+            for (Move otherMv : mvlist) {
+                const Square otherSq {getFromSq(otherMv)};
+                if (otherSq == fromSq || isCastling(otherMv)) {
+                    continue;
+                }
+                isAmbiguous = true;
+                isFileShared |= (getFileIdx(otherSq) == getFileIdx(fromSq));
+                isRankShared |= (getRankIdx(otherSq) == getRankIdx(fromSq));
+            }
+            if (isAmbiguous && (!isFileShared || isRankShared)) {
+                san.push_back('a' + getFileIdx(fromSq));
+            }
+            if (isAmbiguous && isFileShared) {
+                san.push_back('1' + getRankIdx(fromSq));
+            }
+        }
+        if (isCapture) {
+            san.push_back('x');
+        }
+        san.push_back('a' + getFileIdx(toSq));
+        san.push_back('1' + getRankIdx(toSq));
+        if (isPromotion(mv)) {
+            san.push_back('=');
+            san.push_back(PIECE_CHARS[getPromotionType(mv)]);
+        }
+    }
+    
+    const Colour co {pos.getSideToMove()};
+    pos.makeMove(mv);
+    if (validator.isInCheck(!co, pos)) {
+        san.push_back(validator.hasLegalMove(pos) ? '+' : '#');
+    }
+    pos.unmakeMove(mv);
+    return san;
+}
+
+GameReplayer::GameReplayer(Variant defaultVariant)
+    : defaultVariant{defaultVariant}
+{
+}
+
+PgnError GameReplayer::replay(const PgnGame& game) {
+    /// Plays the movetext's SAN moves, skipping move numbers, comments,
+    /// variations and NAGs, up to the game termination marker (or the end of
+    /// the movetext).
+    moves.clear();
+    errorToken = std::string_view {};
+    const PgnError err {setUp(game.tags)};
+    if (err != PGN_OK) {
+        return err;
+    }
+    const std::string_view text {game.movetext};
+    const std::size_t size {text.size()};
+    std::size_t i {0};
+    while (i < size) {
+        const char c {text[i]};
+        if (c == '{') {
+            const std::size_t end {text.find('}', i)};
+            if (end == std::string_view::npos) {
+                errorToken = text.substr(i);
+                return PGN_UNTERMINATED;
+            }
+            i = end + 1;
+            continue;
+        }
+        if (c == ';' || c == '%') {
+            i = text.find('\n', i);
+            continue; // npos ends the loop
+        }
+        if (c == '(') {
+            const std::size_t end {skipVariation(text, i)};
+            if (end == std::string_view::npos) {
+                errorToken = text.substr(i);
+                return PGN_UNTERMINATED;
+            }
+            i = end;
+            continue;
+        }
+        // Whitespace and stray brackets.
+        if (isTokenEnd(c) && c != '$') {
+            ++i;
+            continue;
+        }
+        std::size_t end {i + 1};
+        while (end < size && !isTokenEnd(text[end])) {
+            ++end;
+        }
+        std::string_view token {text.substr(i, end - i)};
+        i = end;
+        // NAGs, e.g. "$14".
+        if (c == '$') {
+            continue;
+        }
+        if (isResult(token)) {
+            break;
+        }
+        // A move number ("12." or "12...") may run straight into the move.
+        std::size_t numEnd {0};
+        while (numEnd < token.size() && isDigit(token[numEnd])) {
+            ++numEnd;
+        }
+        std::size_t dotsEnd {numEnd};
+        while (dotsEnd < token.size() && token[dotsEnd] == '.') {
+            ++dotsEnd;
+        }
+        if (dotsEnd > numEnd) {
+            token.remove_prefix(dotsEnd);
+            if (token.empty()) {
+                continue;
+            }
+        }
+        Move mv {0};
+        const PgnError sanErr {parseSan(token, *pos, validator, mv)};
+        if (sanErr != PGN_OK) {
+            errorToken = token;
+            return sanErr;
+        }
+        // Replay never goes back, so no undo information is kept.
+        pos->makeMoveNoUndo(mv);
+        moves.push_back(mv);
+    }
+    return PGN_OK;
+}
+
+PgnError GameReplayer::setUp(std::string_view tags) {
+    fen = findTag(tags, "FEN");
+    const std::string_view variantName {findTag(tags, "Variant")};
+    if (variantName.empty()) {
+        variant = defaultVariant;
+    } else if (isEqualIgnoringCase(variantName, "Atomic")) {
+        variant = ATOMIC;
+    } else if (isEqualIgnoringCase(variantName, "Standard")
+               || isEqualIgnoringCase(variantName, "From Position")) {
+        variant = ORTHO;
+    } else {
+        return PGN_BAD_VARIANT;
+    }
+    validator.setVariant(variant);
+    if (variant == ATOMIC) {
+        pos = &atomicPos;
+    } else {
+        pos = &orthoPos;
+    }
+    if (pos->parseFen(fen.empty() ? START_FEN : fen) != FEN_OK) {
+        return PGN_BAD_FEN;
+    }
+    return PGN_OK;
+}
+
+
+// === Auxiliary functions ===
+bool isDigit(char c) {
+    return '0' <= c && c <= '9';
+}
+
+bool isTokenEnd(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '{'
+           || c == '}' || c == '(' || c == ')' || c == ';' || c == '$';
+}
+
+bool isResult(std::string_view token) {
+    return token == "1-0" || token == "0-1" || token == "1/2-1/2"
+           || token == "*";
+}
+
+bool isEqualIgnoringCase(std::string_view lhs, std::string_view rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < lhs.size(); ++i) {
+        if ((lhs[i] | 0x20) != (rhs[i] | 0x20)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::size_t skipVariation(std::string_view text, std::size_t i) {
+    /// Returns the index just past the variation opening at text[i] (nested
+    /// variations and comments included), or npos if it is not closed.
+    int depth {0};
+    while (i < text.size()) {
+        const char c {text[i]};
+        if (c == '{') {
+            i = text.find('}', i);
+            if (i == std::string_view::npos) {
+                return i;
+            }
+        } else if (c == ';') {
+            i = text.find('\n', i);
+            if (i == std::string_view::npos) {
+                return i;
+            }
+        } else if (c == '(') {
+            ++depth;
+        } else if (c == ')' && --depth == 0) {
+            return i + 1;
+        }
+        ++i;
+    }
+    return std::string_view::npos;
+}
+
+PieceType pieceTypeFromSan(char c) {
+    switch (c) {
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+        case 'K': return KING;
+        default: return NO_PCTY;
+    }
+}
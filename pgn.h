@@ -0,0 +1,111 @@
+#ifndef PGN_INCLUDED
+#define PGN_INCLUDED
+
+#include "atomic_position.h"
+#include "chess_types.h"
+#include "move.h"
+#include "move_validator.h"
+#include "ortho_position.h"
+#include "position.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// === pgn.h ===
+// Reading games in PGN (Portable Game Notation) without copying the text: a
+// PgnReader splits its input (e.g. a MappedFile) into games, and a
+// GameReplayer plays each game's SAN moves through a Position of the game's
+// variant.
+//
+// SAN (Standard Algebraic Notation) names the moving piece type and the
+// destination, so a move is resolved by generating just the legal moves of
+// that piece type onto that square, then disambiguating by the from-file,
+// from-rank and promotion type given.
+
+enum PgnError {
+    PGN_OK,
+    PGN_BAD_FEN, // FEN tag does not parse, or sets up no valid position
+    PGN_BAD_VARIANT, // Variant tag names a variant that is not supported
+    PGN_BAD_SAN, // a movetext token is not SAN
+    PGN_ILLEGAL_MOVE, // no legal move matches the SAN
+    PGN_AMBIGUOUS_MOVE, // more than one legal move matches the SAN
+    PGN_UNTERMINATED // a comment or variation runs past the end of the game
+};
+const char* describePgnError(PgnError err);
+
+// One game, as views into the reader's input.
+struct PgnGame {
+    std::string_view tags; // the tag pair section, e.g. [Event "..."] lines
+    std::string_view movetext;
+    std::size_t offset {0}; // of the game's first byte in the input
+};
+
+class PgnReader {
+    /// Splits PGN text into games. A game is its tag pairs followed by its
+    /// movetext; the next tag pair at the start of a line (outside a comment)
+    /// begins the next game. The input must outlive the games read from it.
+    public:
+    explicit PgnReader(std::string_view text) : text{text} {}
+    
+    // Reads the next game, returning false at the end of the input.
+    bool nextGame(PgnGame& game);
+    std::size_t getOffset() const {return offset;}
+    
+    private:
+    std::string_view text;
+    std::size_t offset {0};
+};
+
+// The value of the named tag in a tag pair section (escapes are left in), or
+// an empty view if the tag is missing.
+std::string_view findTag(std::string_view tags, std::string_view name);
+
+// Resolves a SAN move (check and annotation suffixes allowed) against the
+// legal moves of pos.
+PgnError parseSan(std::string_view san, Position& pos,
+                  MoveValidator& validator, Move& mv);
+// The SAN of a legal move, with a '+' or '#' suffix for check or checkmate.
+std::string toSan(Move mv, Position& pos, MoveValidator& validator);
+
+class GameReplayer {
+    /// Replays games from a PgnReader. Owns one Position per variant and picks
+    /// the one named by the game's Variant tag (defaultVariant if there is
+    /// none), set up from its FEN tag (the standard start if there is none).
+    ///
+    /// The results of the last replay stay available until the next one.
+    /// The movelist is reused, so replaying does not allocate once it has
+    /// grown to the longest game seen.
+    public:
+    explicit GameReplayer(Variant defaultVariant = ORTHO);
+    
+    PgnError replay(const PgnGame& game);
+    
+    Variant getVariant() const {return variant;}
+    // The FEN tag of the game, or an empty view for the standard start.
+    std::string_view getFen() const {return fen;}
+    // The moves made (on error, those before the failing move).
+    const std::vector<Move>& getMoves() const {return moves;}
+    // The position after the moves made.
+    Position& getPosition() {return *pos;}
+    // How that position ends the game, if it does.
+    GameResult getGameResult() {return validator.gameResult(*pos);}
+    // On error, the offending token (empty for tag errors).
+    std::string_view getErrorToken() const {return errorToken;}
+    
+    private:
+    Variant defaultVariant;
+    Variant variant {ORTHO};
+    MoveValidator validator;
+    OrthoPosition orthoPos;
+    AtomicPosition atomicPos;
+    Position* pos {&orthoPos};
+    std::string_view fen;
+    std::vector<Move> moves;
+    std::string_view errorToken;
+    
+    PgnError setUp(std::string_view tags);
+};
+
+#endif //#ifndef PGN_INCLUDED
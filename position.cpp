@@ -1,92 +1,306 @@
 #include "position.h"
 
 #include "bitboard.h"
+#include "bitboard_lookup.h"
 #include "chess_types.h"
 #include "move.h"
 
 #include <array>
-#include <cctype>
+#include <cstddef>
+#include <initializer_list>
 #include <memory>
-#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 
+// Piece for each (ASCII) FEN character, NO_PIECE if none.
+constexpr std::array<Piece, 128> generatePieceFromChar() {
+    constexpr char pieceChars[] {"PNBRQKpnbrqk"};
+    std::array<Piece, 128> table {};
+    for (Piece& pc : table) {
+        pc = NO_PIECE;
+    }
+    for (int ipc = 0; ipc < NUM_PIECES; ++ipc) {
+        table[pieceChars[ipc]] = static_cast<Piece>(ipc);
+    }
+    return table;
+}
+constexpr std::array<Piece, 128> PIECE_FROM_CHAR {generatePieceFromChar()};
+
+// Declaring auxiliary functions not exposed in .h
+const char* describeFenError(FenError err);
+char* writeNumber(char* out, int num);
+
 Position& Position::fromFen(const std::string& fenStr) {
     /// Reads a FEN string and sets up the Position accordingly.
     /// 
-    // TODO: Make it more robust in terms of accepting input.
-    std::istringstream fenSs(fenStr);
-    fenSs >> std::noskipws;
-    unsigned char token {0};
-    int isq {static_cast<int>(SQ_A8)};
-    size_t idx {std::string::npos};
+    const FenError err {parseFen(fenStr)};
+    if (err != FEN_OK) {
+        throw std::runtime_error(describeFenError(err));
+    }
+    return *this;
+}
+
+FenError Position::parseFen(std::string_view fen) {
+    /// Reads the FEN fields in order, validating each as it goes. Fields may
+    /// be separated by any number of spaces or tabs.
+    const std::size_t len {fen.size()};
+    std::size_t i {0};
+    auto isSep = [&fen](std::size_t j) {
+        return fen[j] == ' ' || fen[j] == '\t';
+    };
+    auto skipSeps = [&]() {
+        while (i < len && isSep(i)) {
+            ++i;
+        }
+    };
+    auto fail = [this](FenError err) {
+        reset();
+        return err;
+    };
     
-    // Clear board.
+    // Clear board. The key is then kept up to date as pieces are added, and
+    // the game state part of it replaced at the end.
     reset();
-    // Read physical position
-    while ((fenSs >> token) && !isspace(token)) {
-        if (isdigit(token)) {
-            isq += static_cast<int>(token - '0'); // char '0' != int 0
+    const Key keyEmptyState {stateKey()};
+    // Read physical position, from a8 rank by rank.
+    skipSeps();
+    int irank {7};
+    int ifile {0};
+    for (; i < len && !isSep(i); ++i) {
+        const unsigned char token = fen[i];
+        if ('1' <= token && token <= '8') {
+            ifile += token - '0'; // char '0' != int 0
         } else if (token == '/') {
-            isq -= 8 + 8; // "square 9" of rank wraps up; must go down 2 ranks.
-        } else if ((idx = PIECE_CHARS.find(token)) != std::string::npos) {
-            addPiece(piece(idx), square(isq));
-            ++isq;
+            if (ifile != 8 || irank == 0) {
+                return fail(FEN_BAD_BOARD);
+            }
+            --irank;
+            ifile = 0;
+            continue;
+        } else if (token < PIECE_FROM_CHAR.size()
+                   && PIECE_FROM_CHAR[token] != NO_PIECE && ifile < 8) {
+            addPiece(PIECE_FROM_CHAR[token], square(8*irank + ifile));
+            ++ifile;
         } else {
-            throw std::runtime_error("Unknown character in FEN position.");
+            return fail(FEN_BAD_BOARD);
+        }
+        if (ifile > 8) {
+            return fail(FEN_BAD_BOARD);
         }
     }
-    // while loop ate 1 whitespace. Assume only 1 whitespace between blocks.
-    // Read side to move; assumes only 1 character.
-    if (fenSs >> token) {
-        switch (std::tolower(token)) {
-            case 'w': {sideToMove = WHITE; break;}
-            case 'b': {sideToMove = BLACK; break;}
-            default: {
-                throw std::runtime_error("Unknown side to move in FEN.");
-                break;
-            }
+    if (irank != 0 || ifile != 8) {
+        return fail(FEN_BAD_BOARD);
+    }
+    // Each side has one king (in atomic, at most one, as a king may have
+    // exploded), and no pawns stand on the first or last rank.
+    for (Colour co : {WHITE, BLACK}) {
+        const int numKings {popcount(getUnitsBb(co, KING))};
+        if (numKings > 1 || (numKings == 0 && getVariant() != ATOMIC)) {
+            return fail(FEN_BAD_KINGS);
         }
     }
-    fenSs >> token; // Assumes (and eats) 1 whitespace.
-    // Read castling rights.
-    while ((fenSs >> token) && !isspace(token)) {
-        switch (token) {
-            case 'K': {castlingRights |= CASTLE_WSHORT; break;}
-            case 'Q': {castlingRights |= CASTLE_WLONG; break;}
-            case 'k': {castlingRights |= CASTLE_BSHORT; break;}
-            case 'q': {castlingRights |= CASTLE_BLONG; break;}
-            case '-': {castlingRights = NO_CASTLE; break;}
-            default: {
-                throw std::runtime_error("Unknown castling rights in FEN.");
+    if (getUnitsBb(PAWN) & (BB_1 | BB_8)) {
+        return fail(FEN_BAD_PAWNS);
+    }
+    // A missing (exploded) king means the game is already over.
+    variantEnd = !getUnitsBb(WHITE, KING) || !getUnitsBb(BLACK, KING);
+    
+    // Read side to move (one character).
+    skipSeps();
+    if (i == len) {
+        return fail(FEN_BAD_SIDE);
+    }
+    switch (fen[i++]) {
+        case 'w': case 'W': {sideToMove = WHITE; break;}
+        case 'b': case 'B': {sideToMove = BLACK; break;}
+        default: {return fail(FEN_BAD_SIDE);}
+    }
+    if (i < len && !isSep(i)) {
+        return fail(FEN_BAD_SIDE);
+    }
+    
+    // Read castling rights: '-', or each of KQkq at most once.
+    skipSeps();
+    if (i < len && fen[i] == '-') {
+        ++i;
+    } else {
+        const std::size_t start {i};
+        for (; i < len && !isSep(i); ++i) {
+            CastlingRights cr {NO_CASTLE};
+            switch (fen[i]) {
+                case 'K': {cr = CASTLE_WSHORT; break;}
+                case 'Q': {cr = CASTLE_WLONG; break;}
+                case 'k': {cr = CASTLE_BSHORT; break;}
+                case 'q': {cr = CASTLE_BLONG; break;}
+                default: {return fail(FEN_BAD_CASTLING);}
+            }
+            if (castlingRights & cr) {
+                return fail(FEN_BAD_CASTLING);
             }
+            castlingRights |= cr;
         }
+        if (i == start) {
+            return fail(FEN_BAD_CASTLING);
+        }
+    }
+    if (i < len && !isSep(i)) {
+        return fail(FEN_BAD_CASTLING);
     }
-    // while loop ate 1 whitespace.
-    // Read en passant rights (one square).
-    while ((fenSs >> token) && !isspace(token)) {
-        if (token == '-') {epRights = NO_SQ; break;}
-        else if (('a' <= token) && (token <= 'h')) {
-            int x = static_cast<int>(token - 'a');
-            if ((fenSs >> token) && ('1' <= token) && (token <= '8')) {
-                int y = static_cast<int>(token - '1');
-                epRights = square(x, y);
+    
+    // Read en passant rights: '-', or one square.
+    skipSeps();
+    if (i < len && fen[i] == '-') {
+        ++i;
+    } else if (i + 1 < len && 'a' <= fen[i] && fen[i] <= 'h'
+               && fen[i + 1] == ((sideToMove == WHITE) ? '6' : '3')) {
+        // The pawn that just made a double step must stand in front of the
+        // square, with the square and the one behind it empty.
+        epRights = square(fen[i] - 'a', fen[i + 1] - '1');
+        const Colour co {sideToMove};
+        if (mailbox[shiftForward(epRights, !co)] != piece(!co, PAWN)
+            || mailbox[epRights] != NO_PIECE
+            || mailbox[shiftForward(epRights, co)] != NO_PIECE) {
+            return fail(FEN_BAD_EP);
+        }
+        i += 2;
+    } else {
+        return fail(FEN_BAD_EP);
+    }
+    if (i < len && !isSep(i)) {
+        return fail(FEN_BAD_EP);
+    }
+    
+    // Read fifty-move and fullmove counters, if given.
+    int counters[2] {0, 1};
+    for (int& counter : counters) {
+        skipSeps();
+        if (i == len) {
+            break;
+        }
+        const std::size_t start {i};
+        int num {0};
+        for (; i < len && '0' <= fen[i] && fen[i] <= '9'; ++i) {
+            if (i - start >= 9) { // a tenth digit could overflow
+                return fail(FEN_BAD_COUNTERS);
             }
-        } else {
-            throw std::runtime_error("Unknown en passant rights in FEN.");
+            num = 10*num + (fen[i] - '0');
         }
+        if (i == start || (i < len && !isSep(i))) {
+            return fail(FEN_BAD_COUNTERS);
+        }
+        counter = num;
+    }
+    skipSeps();
+    if (i != len) {
+        return fail(FEN_BAD_COUNTERS);
     }
-    // while loop ate 1 whitespace.
-    // Read fifty-move and fullmove counters (assumes each is one integer)
-    int fullmoveNum {1};
-    fenSs >> std::skipws >> fiftyMoveNum >> fullmoveNum;
-    // Converting a fullmove number to halfmove number.
+    fiftyMoveNum = counters[0];
+    // Converting a fullmove number to halfmove number. (A fullmove number of
+    // 0, as some programs write, is taken as 1.)
     // Halfmove 0 = Fullmove 1 + white to move.
+    const int fullmoveNum {(counters[1] > 0) ? counters[1] : 1};
     halfmoveNum = (sideToMove == WHITE)
                   ? 2*fullmoveNum - 2
                   : 2*fullmoveNum - 1;
-    return *this;
+    key ^= keyEmptyState ^ stateKey();
+    return FEN_OK;
+}
+
+std::size_t Position::toFen(char* buf, std::size_t bufSize) const {
+    /// Writes the FEN of the position into buf.
+    /// 
+    if (bufSize < MAX_FEN_LENGTH) {
+        return 0;
+    }
+    char* out {buf};
+    // Physical position, from a8 rank by rank.
+    for (int irank = 7; irank >= 0; --irank) {
+        int numEmpty {0};
+        for (int ifile = 0; ifile < 8; ++ifile) {
+            const Piece pc {mailbox[8*irank + ifile]};
+            if (pc == NO_PIECE) {
+                ++numEmpty;
+                continue;
+            }
+            if (numEmpty) {
+                *out++ = static_cast<char>('0' + numEmpty);
+                numEmpty = 0;
+            }
+            *out++ = PIECE_CHARS[pc];
+        }
+        if (numEmpty) {
+            *out++ = static_cast<char>('0' + numEmpty);
+        }
+        if (irank) {
+            *out++ = '/';
+        }
+    }
+    *out++ = ' ';
+    *out++ = (sideToMove == WHITE) ? 'w' : 'b';
+    *out++ = ' ';
+    if (castlingRights == NO_CASTLE) {
+        *out++ = '-';
+    }
+    for (int i = 0; i < NUM_CASTLES; ++i) {
+        if (castlingRights & CASTLE_LIST[i]) {
+            *out++ = "KQkq"[i];
+        }
+    }
+    *out++ = ' ';
+    if (epRights == NO_SQ) {
+        *out++ = '-';
+    } else {
+        *out++ = static_cast<char>('a' + getFileIdx(epRights));
+        *out++ = static_cast<char>('1' + getRankIdx(epRights));
+    }
+    *out++ = ' ';
+    out = writeNumber(out, fiftyMoveNum);
+    *out++ = ' ';
+    out = writeNumber(out, halfmoveNum / 2 + 1);
+    *out = '\0';
+    return static_cast<std::size_t>(out - buf);
+}
+
+Key Position::computeKey() const {
+    /// Computes the Zobrist key of the position from scratch.
+    ///
+    Key k {ZOBRIST.variant[getVariant()] ^ stateKey()};
+    Bitboard bb {getUnitsBb()};
+    while (bb) {
+        const Square sq {popLsb(bb)};
+        k ^= ZOBRIST.pieces[mailbox[sq]][sq];
+    }
+    return k;
+}
+
+void Position::computeAttacks() const {
+    /// Fills attacksByColour from scratch, for the current key.
+    ///
+    const Bitboard bbAll {getUnitsBb()};
+    for (Colour co : {WHITE, BLACK}) {
+        const Bitboard bbPawns {getUnitsBb(co, PAWN)};
+        Bitboard bbAttacked {(co == WHITE)
+                             ? (shiftNW(bbPawns) | shiftNE(bbPawns))
+                             : (shiftSW(bbPawns) | shiftSE(bbPawns))};
+        Bitboard bb {getUnitsBb(co, KNIGHT)};
+        while (bb) {
+            bbAttacked |= knightAttacks[popLsb(bb)];
+        }
+        bb = getUnitsBb(co, BISHOP) | getUnitsBb(co, QUEEN);
+        while (bb) {
+            bbAttacked |= findBishopAttacks(popLsb(bb), bbAll);
+        }
+        bb = getUnitsBb(co, ROOK) | getUnitsBb(co, QUEEN);
+        while (bb) {
+            bbAttacked |= findRookAttacks(popLsb(bb), bbAll);
+        }
+        attacksByColour[co] = bbAttacked;
+    }
+    attacksKey = key;
+    isAttacksCached = true;
+    return;
 }
 
 std::string Position::pretty() const {
@@ -157,6 +371,7 @@ void Position::addPiece(Piece pc, Square sq) {
     bbByColour[co] ^= sq;
     bbByType[pcty] ^= sq;
     mailbox[sq] = pc;
+    key ^= ZOBRIST.pieces[pc][sq];
     return;
 }
 
@@ -165,6 +380,7 @@ void Position::addPiece(Colour co, PieceType pcty, Square sq) {
     bbByColour[co] ^= sq;
     bbByType[pcty] ^= sq;
     mailbox[sq] = piece(co, pcty);
+    key ^= ZOBRIST.pieces[piece(co, pcty)][sq];
 }
 
 void Position::addPiece(int ico, int ipcty, Square sq) {
@@ -172,6 +388,7 @@ void Position::addPiece(int ico, int ipcty, Square sq) {
     bbByColour[ico] ^= sq;
     bbByType[ipcty] ^= sq;
     mailbox[sq] = piece(ico, ipcty);
+    key ^= ZOBRIST.pieces[piece(ico, ipcty)][sq];
 }
 
 void Position::removePiece(Colour co, PieceType pcty, Square sq) {
@@ -179,6 +396,7 @@ void Position::removePiece(Colour co, PieceType pcty, Square sq) {
     bbByColour[co] ^= sq;
     bbByType[pcty] ^= sq;
     mailbox[sq] = NO_PIECE;
+    key ^= ZOBRIST.pieces[piece(co, pcty)][sq];
 }
 
 void Position::makeCastlingMove(Move mv) {
@@ -217,13 +435,18 @@ void Position::makeCastlingMove(Move mv) {
     mailbox[sqKTo] = piece(co, KING);
     mailbox[sqRTo] = piece(co, ROOK);
     
-    // Save irreversible information in struct, *before* altering them.
-    undoStack.emplace_back(NO_PIECE, castlingRights, epRights, fiftyMoveNum);
+    // (Irreversible information must be saved by the caller beforehand.)
+    const Piece king {piece(co, KING)};
+    const Piece rook {piece(co, ROOK)};
+    key ^= ZOBRIST.pieces[king][sqKFrom] ^ ZOBRIST.pieces[king][sqKTo]
+           ^ ZOBRIST.pieces[rook][sqRFrom] ^ ZOBRIST.pieces[rook][sqRTo];
+    key ^= stateKey();
     // Update ep and castling rights.
     epRights = NO_SQ;
     castlingRights &= (co == WHITE) ? ~CASTLE_WHITE : ~CASTLE_BLACK;
     // Change side to move, and update fifty-move and halfmove counts.
     sideToMove = !sideToMove;
+    key ^= stateKey();
     ++fiftyMoveNum;
     ++halfmoveNum;
     return;
@@ -258,14 +481,14 @@ void Position::unmakeCastlingMove(Move mv) {
         }
     }
     // Grab undo information off the stack. Assumes it matches the move called.
-    StateInfo undoState {undoStack.back()};
-    undoStack.pop_back();
+    const StateInfo& undoState {popState()};
     
     // Revert side to move, castling and ep rights, fifty- and half-move counts.
     sideToMove = !sideToMove;
     castlingRights = undoState.castlingRights;
     epRights = undoState.epRights;
     fiftyMoveNum = undoState.fiftyMoveNum;
+    key = undoState.key;
     halfmoveNum--;
     
     // Put king and rook back on their original squares.
@@ -278,3 +501,32 @@ void Position::unmakeCastlingMove(Move mv) {
     mailbox[sqRTo] = NO_PIECE;
     return;
 }
+
+
+// === Auxiliary functions ===
+const char* describeFenError(FenError err) {
+    switch (err) {
+        case FEN_BAD_BOARD: {return "Bad piece placement in FEN.";}
+        case FEN_BAD_KINGS: {return "Wrong number of kings in FEN.";}
+        case FEN_BAD_PAWNS: {return "Pawns on the first or last rank in FEN.";}
+        case FEN_BAD_SIDE: {return "Unknown side to move in FEN.";}
+        case FEN_BAD_CASTLING: {return "Unknown castling rights in FEN.";}
+        case FEN_BAD_EP: {return "Unknown en passant rights in FEN.";}
+        case FEN_BAD_COUNTERS: {return "Bad move counters in FEN.";}
+        default: {return "No error in FEN.";}
+    }
+}
+
+char* writeNumber(char* out, int num) {
+    // Writes a non-negative number in decimal, returning the end of it.
+    char digits[10];
+    int numDigits {0};
+    do {
+        digits[numDigits++] = static_cast<char>('0' + num % 10);
+        num /= 10;
+    } while (num > 0);
+    while (numDigits > 0) {
+        *out++ = digits[--numDigits];
+    }
+    return out;
+}
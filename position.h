@@ -4,10 +4,15 @@
 #include "bitboard.h"
 #include "chess_types.h"
 #include "move.h"
+#include "zobrist.h"
 
 #include <array>
-#include <deque>
+#include <cstddef>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 // === position.h ===
 // An abstract class defining the internal representation of a "physical" chess
@@ -20,12 +25,51 @@
 // - En passant rights
 // - Fifty move counter
 // - Halfmove counter (halfmoves elapsed since start of game).
+// - Zobrist key (hash) of all the above except the counters, and the variant.
 //
 // In addition, it can make/unmake Moves given to it, changing its state
 // accordingly.
 // Ensure state is updated correctly to maintain a valid Position!
+//
+// All of the above lives in one trivially copyable PositionState, so as an
+// alternative to make/unmake, a saved state can simply be copied back
+// ("copy-make").
+
+struct PositionState {
+    std::array<Bitboard, NUM_COLOURS> bbByColour {};
+    std::array<Bitboard, NUM_PIECE_TYPES> bbByType {};
+    std::array<Piece, NUM_SQUARES> mailbox {};
+    Key key {0};
+    // Game state information
+    Colour sideToMove {WHITE};
+    CastlingRights castlingRights {NO_CASTLE};
+    Square epRights {NO_SQ};
+    int fiftyMoveNum {0};
+    int halfmoveNum {0};
+    // for variant use
+    bool variantEnd {false};
+};
+static_assert(std::is_trivially_copyable<PositionState>::value,
+              "PositionState must be cheap to copy for copy-make.");
+
+// The standard starting position.
+constexpr std::string_view START_FEN {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+};
 
-class Position {
+// Result of parsing a FEN string.
+enum FenError {
+    FEN_OK,
+    FEN_BAD_BOARD, // unknown character, or not 8 ranks of 8 squares
+    FEN_BAD_KINGS, // not one king per side (at most one, in atomic)
+    FEN_BAD_PAWNS, // pawns on the first or last rank
+    FEN_BAD_SIDE, // side to move not 'w' or 'b'
+    FEN_BAD_CASTLING, // not '-' or each of KQkq at most once
+    FEN_BAD_EP, // not '-', or no pawn can just have double-stepped past it
+    FEN_BAD_COUNTERS // move counters (optional) not numbers, or trailing text
+};
+
+class Position : protected PositionState {
     // Making/unmaking moves and resetting all member variables (including
     // subclass-specific ones) are not part of the physical position, and depend
     // on the variant.
@@ -33,13 +77,50 @@ class Position {
     virtual void makeMove(Move mv) = 0;
     virtual void unmakeMove(Move mv) = 0;
     virtual void reset() = 0;
+    virtual Variant getVariant() const = 0;
+    // Deep copy (including undo information), e.g. one per worker thread.
+    virtual std::unique_ptr<Position> clone() const = 0;
+    
+    // --- Copy-make ---
+    // Alternative to makeMove/unmakeMove: save getState(), make moves with
+    // makeMoveNoUndo (which records no undo information), then restore the
+    // saved state with setState(). Do not unmakeMove across such moves.
+    virtual void makeMoveNoUndo(Move mv) = 0;
+    const PositionState& getState() const {
+        return *this;
+    }
+    void setState(const PositionState& state) {
+        static_cast<PositionState&>(*this) = state;
+        return;
+    }
+    // Returns the state after making mv, leaving the position unchanged.
+    PositionState copyMake(Move mv) {
+        const PositionState saved {getState()};
+        makeMoveNoUndo(mv);
+        const PositionState next {getState()};
+        setState(saved);
+        return next;
+    }
     
     public:
     Position() {
         mailbox.fill(NO_PIECE);
     }
     
+    // Sets up the position from a FEN string. Throws std::runtime_error if
+    // the FEN is malformed.
     Position& fromFen(const std::string& fenStr);
+    // As above, but returns an error code instead, and never allocates. The
+    // move counters may be left out. On error, the position is left reset.
+    FenError parseFen(std::string_view fen);
+    // Writes the FEN (NUL-terminated) into buf without allocating, returning
+    // its length. Writes nothing and returns 0 if bufSize < MAX_FEN_LENGTH.
+    static constexpr std::size_t MAX_FEN_LENGTH {128};
+    std::size_t toFen(char* buf, std::size_t bufSize) const;
+    std::string toFen() const {
+        char buf[MAX_FEN_LENGTH];
+        return std::string(buf, toFen(buf, MAX_FEN_LENGTH));
+    }
     
     // --- Getters ---        
     Bitboard getUnitsBb(Colour co, PieceType pcty) const {
@@ -56,7 +137,7 @@ class Position {
         for (int ico = 0; ico < NUM_COLOURS; ++ico) {bb |= bbByColour[ico];}
         return bb;
     }
-    std::array<Piece, NUM_SQUARES> getMailbox() const {
+    const std::array<Piece, NUM_SQUARES>& getMailbox() const {
         return mailbox;
     }
     Piece getMailbox(Square sq) const {
@@ -75,6 +156,21 @@ class Position {
     bool isVariantEnd() const {
         return variantEnd;
     }
+    // Zobrist key, kept up to date incrementally. Valid after reset/fromFen.
+    Key getKey() const {
+        return key;
+    }
+    
+    // --- Attack maps ---
+    // Squares attacked by co's units other than the king (king attacks depend
+    // on the variant). Computed lazily and cached until the key changes, i.e.
+    // until the position is changed in any way.
+    Bitboard getAttacksBb(Colour co) const {
+        if (!isAttacksCached || attacksKey != key) {
+            computeAttacks();
+        }
+        return attacksByColour[co];
+    }
     
     // Exposed for convenience for legal move checking.
     // Intentionally restricted to king to prevent temptation to overuse method.
@@ -110,19 +206,18 @@ class Position {
     protected:
     struct StateInfo;
     // --- Class data members ---
-    std::array<Bitboard, NUM_COLOURS> bbByColour {};
-    std::array<Bitboard, NUM_PIECE_TYPES> bbByType {};
-    std::array<Piece, NUM_SQUARES> mailbox {};
-    // Game state information
-    Colour sideToMove {WHITE};
-    CastlingRights castlingRights {NO_CASTLE};
-    Square epRights {NO_SQ};
-    int fiftyMoveNum {0};
-    int halfmoveNum {0};
-    // for variant use
-    bool variantEnd {false};
-    // Stack of unrestorable information for unmaking moves.
-    std::deque<StateInfo> undoStack {};
+    // (The physical position and game state are inherited from PositionState.)
+    // Stack of unrestorable information for unmaking moves, indexed by the
+    // number of moves made since setup (undoPly). Records are preallocated
+    // and reused; the stack only grows if a game outruns UNDO_STACK_SIZE.
+    static constexpr int UNDO_STACK_SIZE {1024};
+    std::vector<StateInfo> undoStack = std::vector<StateInfo>(UNDO_STACK_SIZE);
+    int undoPly {0};
+    
+    // Attack map caches, tagged with the key they were computed for.
+    mutable std::array<Bitboard, NUM_COLOURS> attacksByColour {};
+    mutable Key attacksKey {0};
+    mutable bool isAttacksCached {false};
     
     // --- Castling information ---
     // Information to help with validating/making castling moves.
@@ -158,22 +253,78 @@ class Position {
     void makeCastlingMove(Move mv);
     void unmakeCastlingMove(Move mv);
     
+    // Pushes an undo record holding the current irreversible state, and
+    // returns it for any variant-specific additions.
+    StateInfo& saveState(Piece pcCaptured) {
+        if (undoPly == static_cast<int>(undoStack.size())) {
+            undoStack.resize(2 * undoStack.size());
+        }
+        StateInfo& undoState {undoStack[undoPly++]};
+        undoState.capturedPiece = pcCaptured;
+        undoState.castlingRights = castlingRights;
+        undoState.epRights = epRights;
+        undoState.fiftyMoveNum = fiftyMoveNum;
+        undoState.key = key;
+        return undoState;
+    }
+    // Returns the most recently pushed record.
+    const StateInfo& popState() {
+        return undoStack[--undoPly];
+    }
+    
+    void computeAttacks() const;
+    
+    // Hashing helpers. stateKey() covers castling, en passant and side to
+    // move; XOR it out before changing them and back in afterwards.
+    Key computeKey() const;
+    Key stateKey() const {
+        Key k {ZOBRIST.castling[castlingRights]};
+        if (epRights != NO_SQ) {k ^= ZOBRIST.epFile[getFileIdx(epRights)];}
+        if (sideToMove == BLACK) {k ^= ZOBRIST.sideToMove;}
+        return k;
+    }
+    
+    // Atomic only: all units removed by an explosion, as whole bitboards by
+    // colour and type, plus their pieces in square order for the mailbox.
+    // (A blast covers at most 9 squares.)
+    static constexpr int MAX_EXPLODED {9};
+    struct ExplosionInfo {
+        std::array<Bitboard, NUM_COLOURS> bbByColour {};
+        std::array<Bitboard, NUM_PIECE_TYPES> bbByType {};
+        std::array<Piece, MAX_EXPLODED> pieces {};
+    };
+    
     // A struct for irreversible info about the position, for unmaking moves.
+    // Variant-specific information is folded in, to keep one record per ply.
     struct StateInfo {
-        StateInfo(Piece pc, CastlingRights cr, Square sq, int num50)
-            : capturedPiece{pc}
-            , castlingRights{cr}
-            , epRights{sq}
-            , fiftyMoveNum{num50}
-                { }
-        
         Piece capturedPiece {NO_PIECE};
         CastlingRights castlingRights {NO_CASTLE};
         Square epRights {NO_SQ};
         int fiftyMoveNum {0};
+        Key key {0};
+        
+        // Atomic only, for captures: the unit that moved (and exploded), and
+        // all units removed by the explosion.
+        Piece movedPiece {NO_PIECE};
+        ExplosionInfo explosion {};
     };
 };
 
+inline bool operator==(const PositionState& lhs, const PositionState& rhs) {
+    /// The comparison behind Position's operator== (see there), on the states
+    /// alone. Cheapest and most likely to differ first: the bitboards, then
+    /// the game state, and the mailbox (compared in place) last.
+    if (lhs.bbByColour != rhs.bbByColour || lhs.bbByType != rhs.bbByType) {
+        return false;
+    }
+    if (lhs.sideToMove != rhs.sideToMove ||
+        lhs.castlingRights != rhs.castlingRights ||
+        lhs.epRights != rhs.epRights) {
+        return false;
+    }
+    return lhs.mailbox == rhs.mailbox;
+}
+
 inline bool operator==(const Position& lhs, const Position& rhs) {
     /// Default operator override.
     /// Two Positions are the same if they are the same "chess position". This
@@ -185,28 +336,8 @@ inline bool operator==(const Position& lhs, const Position& rhs) {
     /// identical under FIDE.
     /// Note: Positions of which are "physically" identical but of different
     /// variants are considered identical.
-    
-    if (lhs.getMailbox() != rhs.getMailbox()) {
-        return false;
-    }
-    if (lhs.getUnitsBb(WHITE) != rhs.getUnitsBb(WHITE) ||
-        lhs.getUnitsBb(BLACK) != rhs.getUnitsBb(BLACK)) {
-        return false;
-    }
-    if (lhs.getUnitsBb(PAWN) != rhs.getUnitsBb(PAWN) ||
-        lhs.getUnitsBb(KNIGHT) != rhs.getUnitsBb(KNIGHT) ||
-        lhs.getUnitsBb(BISHOP) != rhs.getUnitsBb(BISHOP) ||
-        lhs.getUnitsBb(ROOK) != rhs.getUnitsBb(ROOK) ||
-        lhs.getUnitsBb(QUEEN) != rhs.getUnitsBb(QUEEN) ||
-        lhs.getUnitsBb(KING) != rhs.getUnitsBb(KING)) {
-        return false;
-    }
-    if (lhs.getSideToMove() != rhs.getSideToMove() ||
-        lhs.getCastlingRights() != rhs.getCastlingRights() ||
-        lhs.getEpSq() != rhs.getEpSq()) {
-        return false;
-    }
-    return true;
+    /// (To compare many positions, see PackedPosition in packed_position.h.)
+    return lhs.getState() == rhs.getState();
 }
 inline bool operator!=(const Position& lhs, const Position& rhs) {
     return !(lhs == rhs);
@@ -0,0 +1,187 @@
+#include "position_index.h"
+
+#include "bitboard_lookup.h"
+#include "chess_types.h"
+#include "game_archive.h"
+#include "move.h"
+#include "move_validator.h"
+#include "position.h"
+#include "zobrist.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+constexpr std::string_view INDEX_MAGIC {"BBPI"};
+// Version 2 keeps en passant rights only for legal en passant captures.
+constexpr uint8_t INDEX_VERSION {2};
+
+struct IndexHeader {
+    char magic[4];
+    uint8_t version;
+    uint8_t padding[3];
+    uint64_t numEntries;
+    uint64_t numGames;
+};
+// The entries and offsets are read in place, so must keep their alignment.
+static_assert(sizeof(IndexHeader) == 24 && sizeof(IndexEntry) == 16);
+
+// Declaring auxiliary functions not exposed in .h
+bool isEntryBefore(const IndexEntry& lhs, const IndexEntry& rhs);
+
+Key indexKey(Position& pos, MoveValidator& validator) {
+    /// The legality test only runs when a pawn stands next to the en passant
+    /// square, which is rare.
+    Key key {pos.getKey()};
+    const Square epSq {pos.getEpSq()};
+    if (epSq == NO_SQ) {
+        return key;
+    }
+    const Colour co {pos.getSideToMove()};
+    bool isEpLegal {false};
+    if (pawnAttacks[!co][epSq] & pos.getUnitsBb(co, PAWN)) {
+        Movelist mvlist {};
+        validator.setVariant(pos.getVariant());
+        validator.generateLegalMovesTo(mvlist, pos, PAWN, epSq);
+        isEpLegal = std::any_of(mvlist.begin(), mvlist.end(),
+                                [](Move mv) {return isEp(mv);});
+    }
+    if (!isEpLegal) {
+        key ^= ZOBRIST.epFile[getFileIdx(epSq)];
+    }
+    return key;
+}
+
+ArchiveError PositionIndexBuilder::addArchive(GameDecoder& decoder) {
+    /// A game failing partway, or with a bad FEN, has its entries dropped,
+    /// and the games after it are still indexed (its record's extent is known
+    /// from its header). Game ids carry on from the archives added before.
+    const uint32_t baseId {static_cast<uint32_t>(gameOffsets.size())};
+    ArchiveError firstErr {ARCHIVE_OK};
+    ArchiveError err {ARCHIVE_OK};
+    while ((err = decoder.nextGame()) == ARCHIVE_OK
+           || err == ARCHIVE_BAD_FEN) {
+        const uint32_t gameId {
+            baseId + static_cast<uint32_t>(decoder.getGameId())
+        };
+        if (gameOffsets.size() <= gameId) {
+            gameOffsets.resize(gameId + 1, 0);
+        }
+        gameOffsets[gameId] = decoder.getGameOffset();
+        const std::size_t gameStart {entries.size()};
+        if (err == ARCHIVE_OK) {
+            uint32_t ply {0};
+            entries.push_back({indexKey(decoder.getPosition(), validator),
+                               gameId, ply});
+            Move mv {0};
+            while ((err = decoder.nextMove(mv)) == ARCHIVE_OK) {
+                entries.push_back({indexKey(decoder.getPosition(), validator),
+                                   gameId, ++ply});
+            }
+        }
+        if (err != ARCHIVE_END) {
+            entries.resize(gameStart);
+            if (firstErr == ARCHIVE_OK) {
+                firstErr = err;
+            }
+        }
+    }
+    if (firstErr == ARCHIVE_OK && err != ARCHIVE_END) {
+        firstErr = err;
+    }
+    return firstErr;
+}
+
+void PositionIndexBuilder::write(std::ostream& os) {
+    /// Games revisiting a position keep only their first visit.
+    std::sort(entries.begin(), entries.end(), isEntryBefore);
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const IndexEntry& lhs, const IndexEntry& rhs) {
+                                  return lhs.key == rhs.key
+                                         && lhs.gameId == rhs.gameId;
+                              }),
+                  entries.end());
+    IndexHeader header {};
+    std::memcpy(header.magic, INDEX_MAGIC.data(), INDEX_MAGIC.size());
+    header.version = INDEX_VERSION;
+    header.numEntries = entries.size();
+    header.numGames = gameOffsets.size();
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(entries.data()),
+             entries.size() * sizeof(IndexEntry));
+    os.write(reinterpret_cast<const char*>(gameOffsets.data()),
+             gameOffsets.size() * sizeof(uint64_t));
+}
+
+PositionIndex::PositionIndex(const std::string& path)
+    : file{path, RANDOM_ACCESS}
+{
+    /// Checks the header and that the sizes add up, so that lookups need no
+    /// bounds checks.
+    IndexHeader header {};
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error("Not a position index: " + path);
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::string_view(header.magic, 4) != INDEX_MAGIC
+        || header.version != INDEX_VERSION) {
+        throw std::runtime_error("Not a position index: " + path);
+    }
+    const std::size_t capacity {file.size() - sizeof(header)};
+    if (header.numEntries > capacity / sizeof(IndexEntry)
+        || header.numGames > capacity / sizeof(uint64_t)
+        || header.numEntries * sizeof(IndexEntry)
+           + header.numGames * sizeof(uint64_t) != capacity) {
+        throw std::runtime_error("Truncated position index: " + path);
+    }
+    // Mappings are page-aligned, and buffers aligned for any type.
+    if (reinterpret_cast<std::uintptr_t>(file.data()) % alignof(IndexEntry)) {
+        throw std::runtime_error("Misaligned position index: " + path);
+    }
+    numEntries = header.numEntries;
+    numGames = header.numGames;
+    entries = reinterpret_cast<const IndexEntry*>(file.data() + sizeof(header));
+    gameOffsets = reinterpret_cast<const uint64_t*>(entries + numEntries);
+}
+
+uint64_t PositionIndex::getGameOffset(uint32_t gameId) const {
+    return (gameId < numGames) ? gameOffsets[gameId] : 0;
+}
+
+IndexMatches PositionIndex::find(Key key) const {
+    const IndexEntry* entriesEnd {entries + numEntries};
+    const IndexEntry* first {std::lower_bound(
+        entries, entriesEnd, key,
+        [](const IndexEntry& entry, Key k) {return entry.key < k;})};
+    const IndexEntry* last {std::upper_bound(
+        first, entriesEnd, key,
+        [](Key k, const IndexEntry& entry) {return k < entry.key;})};
+    return {first, last};
+}
+
+FenError PositionIndex::findFen(std::string_view fen, Variant var,
+                                IndexMatches& matches) {
+    Position& pos {(var == ATOMIC) ? static_cast<Position&>(atomicPos)
+                                   : static_cast<Position&>(orthoPos)};
+    const FenError err {pos.parseFen(fen)};
+    matches = (err == FEN_OK) ? find(pos) : IndexMatches {};
+    return err;
+}
+
+
+// === Auxiliary functions ===
+bool isEntryBefore(const IndexEntry& lhs, const IndexEntry& rhs) {
+    if (lhs.key != rhs.key) {
+        return lhs.key < rhs.key;
+    }
+    if (lhs.gameId != rhs.gameId) {
+        return lhs.gameId < rhs.gameId;
+    }
+    return lhs.ply < rhs.ply;
+}
@@ -0,0 +1,116 @@
+#ifndef POSITION_INDEX_INCLUDED
+#define POSITION_INDEX_INCLUDED
+
+#include "atomic_position.h"
+#include "game_archive.h"
+#include "mapped_file.h"
+#include "move_validator.h"
+#include "ortho_position.h"
+#include "position.h"
+#include "zobrist.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// === position_index.h ===
+// An on-disk index from positions to the games of archives reaching them,
+// for answering "which games reach this position" without replaying the
+// collection.
+//
+// The file is the 4 bytes "BBPI", a format version byte, 3 bytes of padding,
+// the number of entries and of games (8 bytes each), then:
+// - the entries (IndexEntry, 16 bytes each), sorted by key, then game,
+// - the offset in its archive of each game (8 bytes each), by game id.
+// Numbers are stored in the host's byte order. The reader maps the file and
+// binary-searches the entries in place, so a lookup only touches the few
+// pages its search goes through.
+//
+// Positions are identified by their Zobrist key, which covers the variant,
+// so one index can hold ORTHO and ATOMIC games. En passant rights only count
+// when an en passant capture is legal, since FENs from other sources often
+// leave them out otherwise (see indexKey).
+
+// Reaching the position with key, at ply (0 for the start position) of the
+// game numbered gameId in the archives indexed. There is one entry per game and
+// position, at the first ply the game reaches it.
+struct IndexEntry {
+    Key key;
+    uint32_t gameId;
+    uint32_t ply;
+};
+
+// The Position's key, less its en passant rights if no legal en passant
+// capture uses them. The validator is set to the position's variant.
+Key indexKey(Position& pos, MoveValidator& validator);
+
+// A range of entries inside a PositionIndex, valid while it is.
+struct IndexMatches {
+    const IndexEntry* first {nullptr};
+    const IndexEntry* last {nullptr};
+    
+    const IndexEntry* begin() const {return first;}
+    const IndexEntry* end() const {return last;}
+    std::size_t size() const {return last - first;}
+    bool empty() const {return first == last;}
+};
+
+class PositionIndexBuilder {
+    /// Collects the positions of games, then writes them as an index. The
+    /// entries are sorted in memory, 16 bytes per position and game.
+    public:
+    // Indexes the positions of every game left in the archive, under the
+    // decoder's game ids plus the number of games added before (so the games
+    // of a second archive are numbered from getNumGames() before the call).
+    // A game with an illegal move or a bad FEN is left out, and the first
+    // such error returned once the rest are indexed. Stops at any other error
+    // in a game's header, after which nothing more can be read.
+    ArchiveError addArchive(GameDecoder& decoder);
+    std::size_t getNumEntries() const {return entries.size();}
+    std::size_t getNumGames() const {return gameOffsets.size();}
+    // Sorts the entries and writes the index.
+    void write(std::ostream& os);
+    
+    private:
+    std::vector<IndexEntry> entries;
+    std::vector<uint64_t> gameOffsets;
+    MoveValidator validator;
+};
+
+class PositionIndex {
+    /// A read-only, memory-mapped index file.
+    public:
+    // Maps the index. Throws std::runtime_error if it cannot be mapped or is
+    // not a valid index.
+    explicit PositionIndex(const std::string& path);
+    
+    std::size_t getNumEntries() const {return numEntries;}
+    std::size_t getNumGames() const {return numGames;}
+    // Offset of the game in its archive, for GameDecoder::seekGame (with the
+    // id less that of the archive's first game).
+    uint64_t getGameOffset(uint32_t gameId) const;
+    
+    // The games reaching the position, by increasing game id.
+    IndexMatches find(Key key) const;
+    IndexMatches find(Position& pos) {
+        return find(indexKey(pos, validator));
+    }
+    FenError findFen(std::string_view fen, Variant var,
+                     IndexMatches& matches);
+    
+    private:
+    MappedFile file;
+    std::size_t numEntries {0};
+    std::size_t numGames {0};
+    const IndexEntry* entries {nullptr};
+    const uint64_t* gameOffsets {nullptr};
+    // For parsing FENs to look up, and testing their en passant rights.
+    OrthoPosition orthoPos;
+    AtomicPosition atomicPos;
+    MoveValidator validator;
+};
+
+#endif //#ifndef POSITION_INDEX_INCLUDED
@@ -91,9 +91,6 @@ int main(int argc, char* argv[]) {
     std::vector<int> idFails;
     Variant var {argc == 3 ? ORTHO : ATOMIC};
     
-    initialiseBbLookup();
-    initialiseAtomicMasks();
-    
     // run each perft, write results to output file
     while (std::getline(ifs, strTest)) {
         ++testId;
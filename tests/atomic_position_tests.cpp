@@ -3,6 +3,7 @@
 #include "bitboard_lookup.h"
 #include "chess_types.h"
 #include "move.h"
+#include "packed_position.h"
 
 #include <chrono>
 #include <cstdlib>
@@ -77,7 +78,12 @@ class SingleMoveTest {
         bool isPassed = true;
         posTest.fromFen(strFenBefore);
         posTest.makeMove(mv);
-        if (posTest != posAfter) {
+        // The incrementally updated key must match one computed from scratch.
+        // The FEN writer must reproduce the expected FEN (the suite's move
+        // counters are not always right, so they are left out).
+        if (posTest != posAfter || posTest.getKey() != posAfter.getKey()
+            || packPosition(posTest) != packPosition(posAfter)
+            || stripCounters(posTest.toFen()) != stripCounters(strFenAfter)) {
             isPassed = false;
             std::cout << strFenBefore << "\n";
             std::cout << posTest.pretty();
@@ -90,7 +96,8 @@ class SingleMoveTest {
         posTest.fromFen(strFenBefore);
         posTest.makeMove(mv);
         posTest.unmakeMove(mv);
-        if (posTest != posBefore) {
+        if (posTest != posBefore || posTest.getKey() != posBefore.getKey()
+            || packPosition(posTest) != packPosition(posBefore)) {
             isPassed = false;
             std::cout << strFenBefore << "\n";
             std::cout << posTest.pretty();
@@ -99,6 +106,15 @@ class SingleMoveTest {
     }
     
     private:
+    std::string stripCounters(const std::string& strFen) {
+        // Keeps the first four fields of the FEN.
+        std::size_t idx {0};
+        for (int i = 0; i < 4 && idx != std::string::npos; ++i) {
+            idx = strFen.find(' ', idx + 1);
+        }
+        return strFen.substr(0, idx);
+    }
+    
     // To refactor for future use if needed
     Square square(std::string cn) {
         //assert xn is of form "e5" or "c1" etc.
@@ -132,9 +148,6 @@ int main(int argc, char* argv[]) {
     int numTests = 0;
     std::vector<int> idFails;
     
-    initialiseBbLookup();
-    initialiseAtomicMasks();
-    
     
     auto timeStart = std::chrono::steady_clock::now();
     // Run each test in the testSuite (parsed from EPD).
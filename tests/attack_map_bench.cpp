@@ -0,0 +1,78 @@
+#include "atomic_capture_masks.h"
+#include "atomic_position.h"
+#include "bitboard_lookup.h"
+#include "move_validator.h"
+#include "ortho_position.h"
+#include "position.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Benchmark of the cached attack maps against recomputing attacks on demand.
+/// Runs perft on each position of an EPD (or FEN) file, once with attack maps
+/// and once without, and reports both times. The node counts must agree.
+
+uint64_t runPerfts(MoveValidator& arbiter, Position& pos,
+                   const std::vector<std::string>& fens, int depth,
+                   double& ms) {
+    uint64_t nodes {0};
+    auto timeStart = std::chrono::steady_clock::now();
+    for (const std::string& strFen : fens) {
+        pos.fromFen(strFen);
+        nodes += arbiter.perft(depth, pos);
+    }
+    auto timeTaken = std::chrono::steady_clock::now() - timeStart;
+    ms = std::chrono::duration<double, std::milli>(timeTaken).count();
+    return nodes;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Run the benchmark with the command [filename] "
+                     "[EPD file path] [Depth]\n"
+                     "Optional argument [] for atomic.\n";
+        return 0;
+    }
+    int depth {std::atoi(argv[2])};
+    Variant var {argc >= 4 ? ATOMIC : ORTHO};
+    
+    MoveValidator arbiter {var};
+    std::unique_ptr<Position> pos;
+    if (var == ORTHO) {
+        pos.reset(new OrthoPosition);
+    } else {
+        pos.reset(new AtomicPosition);
+    }
+    
+    // Only the FEN (up to the first ';') of each line is used.
+    std::ifstream ifs {argv[1]};
+    std::vector<std::string> fens {};
+    std::string strLine;
+    while (std::getline(ifs, strLine)) {
+        fens.push_back(strLine.substr(0, strLine.find(';')));
+    }
+    
+    double msMaps {0};
+    double msRecompute {0};
+    arbiter.setAttackMaps(true);
+    uint64_t nodesMaps {runPerfts(arbiter, *pos, fens, depth, msMaps)};
+    arbiter.setAttackMaps(false);
+    uint64_t nodesRecompute {runPerfts(arbiter, *pos, fens, depth,
+                                       msRecompute)};
+    
+    std::cout << "Nodes: " << std::to_string(nodesMaps) << "\n";
+    std::cout << "Attack maps: " << msMaps << " ms\n";
+    std::cout << "Recompute on demand: " << msRecompute << " ms\n";
+    if (nodesMaps != nodesRecompute) {
+        std::cout << "Node counts differ! (" << std::to_string(nodesRecompute)
+                  << " without attack maps)\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,628 @@
+#include "atomic_capture_masks.h"
+#include "atomic_position.h"
+#include "bitboard_lookup.h"
+#include "game_archive.h"
+#include "mapped_file.h"
+#include "move.h"
+#include "move_validator.h"
+#include "ortho_position.h"
+#include "pgn.h"
+#include "position.h"
+#include "position_index.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Program to test the binary game archive and the position index built from
+/// it, and to time loading games and looking up positions.
+///
+/// With an EPD file, plays random games from each of its positions, encodes
+/// them with plain and with indexed moves, decodes them again and checks
+/// that the same moves and final positions come out. Damaged archives must
+/// report their errors. The position index of the games must then list, for
+/// every position, exactly the games reaching it.
+///
+/// With --pgn, converts the games of a PGN file both ways, and times decoding
+/// against replaying the PGN, and lookups in the index. Optional argument
+/// [--out FILE] saves the plain archive, and its index as FILE.idx.
+
+constexpr int GAMES_PER_POSITION {20};
+constexpr int MAX_PLIES {200};
+constexpr const char* INDEX_TEST_FILE {"position_index_tests.idx"};
+
+struct Game {
+    Variant var;
+    std::string fen;
+    std::vector<Move> moves;
+    Key finalKey;
+};
+
+Game playRandomGame(const std::string& fen, Variant var, std::mt19937& rng) {
+    MoveValidator arbiter {var};
+    std::unique_ptr<Position> pos;
+    if (var == ATOMIC) {
+        pos = std::make_unique<AtomicPosition>();
+    } else {
+        pos = std::make_unique<OrthoPosition>();
+    }
+    pos->fromFen(fen);
+    Game game {var, fen, {}, 0};
+    for (int ply = 0; ply < MAX_PLIES; ++ply) {
+        Movelist mvlist {};
+        arbiter.generateLegalMoves(mvlist, *pos);
+        if (mvlist.empty()) {
+            break;
+        }
+        const Move mv {mvlist[rng() % static_cast<unsigned>(mvlist.size())]};
+        pos->makeMove(mv);
+        game.moves.push_back(mv);
+    }
+    game.finalKey = pos->getKey();
+    return game;
+}
+
+bool checkArchive(const std::string& archive, const std::vector<Game>& games) {
+    /// Decodes every game, comparing moves and final positions.
+    GameDecoder decoder {archive};
+    std::vector<Move> moves;
+    std::size_t numGames {0};
+    ArchiveError err {ARCHIVE_OK};
+    while ((err = decoder.nextGame()) == ARCHIVE_OK) {
+        if (numGames >= games.size()
+            || decoder.readMoves(moves) != ARCHIVE_OK
+            || decoder.getVariant() != games[numGames].var
+            || moves != games[numGames].moves
+            || decoder.getPosition().getKey() != games[numGames].finalKey) {
+            std::cout << "Game " << numGames + 1 << " decoded wrongly\n";
+            return false;
+        }
+        ++numGames;
+    }
+    if (err != ARCHIVE_END || numGames != games.size()) {
+        std::cout << "Decoding stopped after " << numGames << " games: "
+                  << describeArchiveError(err) << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool checkDamagedArchives(const std::string& archive) {
+    /// Cuts the archive short, and corrupts its header.
+    /// (The decoders only view their data, so it is kept alive here.)
+    const std::string truncatedData {archive.substr(0, archive.size() - 1)};
+    const std::string notArchiveData {"BBGX" + archive.substr(4)};
+    GameDecoder truncated {truncatedData};
+    ArchiveError err {ARCHIVE_OK};
+    while ((err = truncated.nextGame()) == ARCHIVE_OK) {
+    }
+    GameDecoder notArchive {notArchiveData};
+    return err == ARCHIVE_TRUNCATED
+           && notArchive.nextGame() == ARCHIVE_BAD_HEADER;
+}
+
+bool checkCorruptMoves() {
+    /// Overwrites the one plain move of a game with moves that are not legal,
+    /// each of which must be refused rather than made.
+    std::ostringstream oss;
+    GameEncoder encoder {oss, false};
+    encoder.addGame(ORTHO, "", {buildMove(SQ_E2, SQ_E4)});
+    const std::string archive {oss.str()};
+    OrthoPosition startPos;
+    startPos.fromFen(std::string {START_FEN});
+    bool isOk {true};
+    for (Move mv : {buildMove(SQ_E2, SQ_E5), buildMove(SQ_E7, SQ_E5),
+                    buildMove(SQ_E3, SQ_E4), buildCastling(SQ_E2, SQ_A1),
+                    buildEp(SQ_E2, SQ_A1), buildPromotion(SQ_E2, SQ_E4, QUEEN),
+                    buildCastling(SQ_E1, SQ_H1)}) {
+        std::string corrupt {archive};
+        corrupt[corrupt.size() - 2] = static_cast<char>(mv & 0xff);
+        corrupt[corrupt.size() - 1] = static_cast<char>(mv >> 8);
+        GameDecoder decoder {corrupt};
+        std::vector<Move> moves;
+        isOk &= decoder.nextGame() == ARCHIVE_OK
+                && decoder.readMoves(moves) == ARCHIVE_ILLEGAL_MOVE
+                && decoder.getPosition() == startPos;
+    }
+    return isOk;
+}
+
+bool checkCorruptFen() {
+    /// Spoils the FEN of the middle of three games, which must be refused
+    /// without losing the game after it.
+    const std::string fen {"4k3/8/8/8/8/8/8/4K3 w - - 0 1"};
+    std::ostringstream oss;
+    GameEncoder encoder {oss, false};
+    encoder.addGame(ORTHO, "", {buildMove(SQ_E2, SQ_E4)});
+    encoder.addGame(ORTHO, fen, {buildMove(SQ_E1, SQ_D1)});
+    encoder.addGame(ORTHO, "", {buildMove(SQ_C2, SQ_C4)});
+    std::string archive {oss.str()};
+    archive[archive.find(fen)] = 'x';
+    
+    GameDecoder decoder {archive};
+    std::vector<Move> moves;
+    return decoder.nextGame() == ARCHIVE_OK
+           && decoder.readMoves(moves) == ARCHIVE_OK
+           && decoder.nextGame() == ARCHIVE_BAD_FEN
+           && decoder.nextGame() == ARCHIVE_OK && decoder.getGameId() == 2
+           && decoder.readMoves(moves) == ARCHIVE_OK
+           && moves == std::vector<Move> {buildMove(SQ_C2, SQ_C4)}
+           && decoder.nextGame() == ARCHIVE_END;
+}
+
+void writeIndex(const std::string& archive, const std::string& indexFile) {
+    GameDecoder decoder {archive};
+    PositionIndexBuilder builder;
+    builder.addArchive(decoder);
+    std::ofstream ofs {indexFile, std::ios::binary};
+    builder.write(ofs);
+}
+
+bool checkIndex(const PositionIndex& index, const std::vector<Game>& games) {
+    /// Compares every lookup with the first visits found by replaying.
+    std::map<Key, std::map<uint32_t, uint32_t>> expected;
+    std::size_t numEntries {0};
+    OrthoPosition orthoPos;
+    AtomicPosition atomicPos;
+    MoveValidator validator;
+    for (uint32_t id = 0; id < games.size(); ++id) {
+        const Game& game {games[id]};
+        Position& pos {(game.var == ATOMIC) ? static_cast<Position&>(atomicPos)
+                                            : static_cast<Position&>(orthoPos)};
+        pos.parseFen(game.fen.empty() ? START_FEN : game.fen);
+        numEntries += expected[indexKey(pos, validator)].emplace(id, 0).second;
+        for (uint32_t ply = 0; ply < game.moves.size(); ++ply) {
+            pos.makeMove(game.moves[ply]);
+            numEntries += expected[indexKey(pos, validator)]
+                          .emplace(id, ply + 1).second;
+        }
+    }
+    if (index.getNumEntries() != numEntries
+        || index.getNumGames() != games.size()) {
+        std::cout << "Index has " << index.getNumEntries() << " entries for "
+                  << index.getNumGames() << " games, expected " << numEntries
+                  << " for " << games.size() << "\n";
+        return false;
+    }
+    for (const auto& [key, gamePlies] : expected) {
+        const IndexMatches matches {index.find(key)};
+        auto it = gamePlies.begin();
+        bool isOk {matches.size() == gamePlies.size()};
+        for (const IndexEntry& entry : matches) {
+            isOk = isOk && entry.gameId == it->first && entry.ply == it->second;
+            ++it;
+        }
+        if (!isOk) {
+            std::cout << "Index lookup of key " << key << " failed\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkIndexLookups(PositionIndex& index, const std::string& archive,
+                       const std::vector<Game>& games) {
+    /// Looks up each game's final position by FEN, then seeks the game in
+    /// the archive from its offset.
+    GameDecoder decoder {archive};
+    std::vector<Move> moves;
+    for (uint32_t id = 0; id < games.size(); ++id) {
+        decoder.seekGame(index.getGameOffset(id), id);
+        if (decoder.nextGame() != ARCHIVE_OK || decoder.getGameId() != id
+            || decoder.readMoves(moves) != ARCHIVE_OK
+            || moves != games[id].moves) {
+            std::cout << "Cannot seek game " << id << "\n";
+            return false;
+        }
+        IndexMatches matches {};
+        const std::string fen {decoder.getPosition().toFen()};
+        const auto isGame = [id](const IndexEntry& entry) {
+            return entry.gameId == id;
+        };
+        if (index.findFen(fen, games[id].var, matches) != FEN_OK
+            || std::none_of(matches.begin(), matches.end(), isGame)) {
+            std::cout << "Game " << id << " not found from " << fen << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkIndexEnPassant() {
+    /// En passant rights only count when the capture is legal. After 1. e4,
+    /// and after ...d5 next to a pawn pinned to its king, a FEN without them
+    /// is the same position; next to a free pawn it is not.
+    std::ostringstream oss;
+    GameEncoder encoder {oss, false};
+    encoder.addGame(ORTHO, "", {buildMove(SQ_E2, SQ_E4)});
+    encoder.addGame(ORTHO, "4r1k1/3p4/8/4P3/8/8/8/4K3 b - - 0 1",
+                    {buildMove(SQ_D7, SQ_D5)});
+    encoder.addGame(ORTHO, "4r1k1/3p4/8/4P3/8/8/8/3K4 b - - 0 1",
+                    {buildMove(SQ_D7, SQ_D5)});
+    writeIndex(oss.str(), INDEX_TEST_FILE);
+    struct Lookup {
+        const char* fen;
+        std::size_t numMatches;
+    };
+    bool isOk {true};
+    {
+        PositionIndex index {INDEX_TEST_FILE};
+        for (const Lookup& lookup : {
+                 Lookup {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b "
+                         "KQkq - 0 1", 1},
+                 Lookup {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b "
+                         "KQkq e3 0 1", 1},
+                 Lookup {"4r1k1/8/8/3pP3/8/8/8/4K3 w - - 0 2", 1},
+                 Lookup {"4r1k1/8/8/3pP3/8/8/8/4K3 w - d6 0 2", 1},
+                 Lookup {"4r1k1/8/8/3pP3/8/8/8/3K4 w - - 0 2", 0},
+                 Lookup {"4r1k1/8/8/3pP3/8/8/8/3K4 w - d6 0 2", 1}
+             }) {
+            IndexMatches matches {};
+            isOk &= index.findFen(lookup.fen, ORTHO, matches) == FEN_OK
+                    && matches.size() == lookup.numMatches
+                    && (matches.empty() || matches.begin()->ply == 1);
+            // Atomic games are apart.
+            isOk &= index.findFen(lookup.fen, ATOMIC, matches) == FEN_OK
+                    && matches.empty();
+        }
+    }
+    std::remove(INDEX_TEST_FILE);
+    return isOk;
+}
+
+bool checkIndexSkipsBadGames() {
+    /// A game with a corrupt move leaves no entries, and the games after it
+    /// are still indexed under their own ids.
+    std::ostringstream oss;
+    GameEncoder encoder {oss, false};
+    encoder.addGame(ORTHO, "", {buildMove(SQ_E2, SQ_E4)});
+    const std::size_t badMoveOffset {oss.str().size() + 2};
+    encoder.addGame(ORTHO, "", {buildMove(SQ_D2, SQ_D4)});
+    encoder.addGame(ORTHO, "", {buildMove(SQ_C2, SQ_C4)});
+    std::string archive {oss.str()};
+    const Move badMove {buildMove(SQ_D2, SQ_D5)};
+    archive[badMoveOffset] = static_cast<char>(badMove & 0xff);
+    archive[badMoveOffset + 1] = static_cast<char>(badMove >> 8);
+    
+    GameDecoder decoder {archive};
+    PositionIndexBuilder builder;
+    if (builder.addArchive(decoder) != ARCHIVE_ILLEGAL_MOVE) {
+        return false;
+    }
+    {
+        std::ofstream ofs {INDEX_TEST_FILE, std::ios::binary};
+        builder.write(ofs);
+    }
+    bool isOk {true};
+    {
+        PositionIndex index {INDEX_TEST_FILE};
+        IndexMatches matches {};
+        // The start position once each for games 0 and 2, and a position
+        // after each of their moves.
+        isOk &= index.getNumEntries() == 4 && index.getNumGames() == 3;
+        isOk &= index.findFen("rnbqkbnr/pppppppp/8/8/2P5/8/PP1PPPPP/RNBQKBNR b "
+                              "KQkq - 0 1", ORTHO, matches) == FEN_OK
+                && matches.size() == 1 && matches.begin()->gameId == 2;
+        isOk &= index.findFen(std::string {START_FEN}, ORTHO, matches)
+                == FEN_OK
+                && matches.size() == 2 && matches.begin()->gameId == 0;
+    }
+    std::remove(INDEX_TEST_FILE);
+    return isOk;
+}
+
+bool checkIndexTwoArchives() {
+    /// The games of a second archive are numbered after those of the first,
+    /// and keep their offsets in their own archive. A game with a bad FEN is
+    /// left out, but still numbered.
+    const std::string fen {"4k3/8/8/8/8/8/8/4K3 w - - 0 1"};
+    std::ostringstream ossFirst;
+    GameEncoder encoderFirst {ossFirst, false};
+    encoderFirst.addGame(ORTHO, "", {buildMove(SQ_E2, SQ_E4)});
+    std::ostringstream ossSecond;
+    GameEncoder encoderSecond {ossSecond, false};
+    encoderSecond.addGame(ORTHO, fen, {buildMove(SQ_E1, SQ_D1)});
+    const std::size_t secondGameOffset {ossSecond.str().size()};
+    encoderSecond.addGame(ORTHO, "", {buildMove(SQ_C2, SQ_C4)});
+    const std::string archiveFirst {ossFirst.str()};
+    std::string archiveSecond {ossSecond.str()};
+    archiveSecond[archiveSecond.find(fen)] = 'x';
+    
+    PositionIndexBuilder builder;
+    GameDecoder decoderFirst {archiveFirst};
+    GameDecoder decoderSecond {archiveSecond};
+    if (builder.addArchive(decoderFirst) != ARCHIVE_OK
+        || builder.addArchive(decoderSecond) != ARCHIVE_BAD_FEN) {
+        return false;
+    }
+    {
+        std::ofstream ofs {INDEX_TEST_FILE, std::ios::binary};
+        builder.write(ofs);
+    }
+    bool isOk {true};
+    {
+        PositionIndex index {INDEX_TEST_FILE};
+        IndexMatches matches {};
+        isOk &= index.getNumEntries() == 4 && index.getNumGames() == 3;
+        isOk &= index.getGameOffset(0) == index.getGameOffset(1)
+                && index.getGameOffset(2) == secondGameOffset;
+        isOk &= index.findFen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b "
+                              "KQkq - 0 1", ORTHO, matches) == FEN_OK
+                && matches.size() == 1 && matches.begin()->gameId == 0;
+        isOk &= index.findFen("rnbqkbnr/pppppppp/8/8/2P5/8/PP1PPPPP/RNBQKBNR b "
+                              "KQkq - 0 1", ORTHO, matches) == FEN_OK
+                && matches.size() == 1 && matches.begin()->gameId == 2;
+        
+        // The game found replays from its own archive.
+        GameDecoder decoder {archiveSecond};
+        std::vector<Move> moves;
+        decoder.seekGame(index.getGameOffset(2), 2 - 1);
+        isOk &= decoder.nextGame() == ARCHIVE_OK
+                && decoder.readMoves(moves) == ARCHIVE_OK
+                && moves == std::vector<Move> {buildMove(SQ_C2, SQ_C4)};
+    }
+    std::remove(INDEX_TEST_FILE);
+    return isOk;
+}
+
+int runPgn(const std::string& pgnFile, Variant var,
+           const std::string& outFile) {
+    /// Converts a PGN file, reporting sizes and load times.
+    const MappedFile file {pgnFile};
+    PgnReader reader {file.view()};
+    GameReplayer replayer {var};
+    PgnGame game;
+    std::ostringstream ossPlain;
+    std::ostringstream ossIndexed;
+    GameEncoder plainEncoder {ossPlain, false};
+    GameEncoder indexedEncoder {ossIndexed, true};
+    std::size_t numGames {0};
+    auto timeStart = std::chrono::steady_clock::now();
+    while (reader.nextGame(game)) {
+        if (replayer.replay(game) != PGN_OK) {
+            continue;
+        }
+        plainEncoder.addGame(replayer.getVariant(), replayer.getFen(),
+                             replayer.getMoves());
+        indexedEncoder.addGame(replayer.getVariant(), replayer.getFen(),
+                               replayer.getMoves());
+        ++numGames;
+    }
+    auto timeEnd = std::chrono::steady_clock::now();
+    const double pgnSeconds {
+        std::chrono::duration<double>(timeEnd - timeStart).count()
+    };
+    std::cout << numGames << " valid games, " << file.size()
+              << " bytes of PGN\n";
+    
+    for (bool isIndexed : {false, true}) {
+        const std::string archive {
+            isIndexed ? ossIndexed.str() : ossPlain.str()
+        };
+        GameDecoder decoder {archive};
+        std::vector<Move> moves;
+        std::size_t numMoves {0};
+        timeStart = std::chrono::steady_clock::now();
+        while (decoder.nextGame() == ARCHIVE_OK) {
+            decoder.readMoves(moves);
+            numMoves += moves.size();
+        }
+        timeEnd = std::chrono::steady_clock::now();
+        const double seconds {
+            std::chrono::duration<double>(timeEnd - timeStart).count()
+        };
+        std::cout << (isIndexed ? "Indexed: " : "Plain: ")
+                  << archive.size() << " bytes ("
+                  << static_cast<double>(archive.size()) / numMoves
+                  << " per move), " << 1e6 * seconds / numGames
+                  << " us per game to load\n";
+    }
+    std::cout << 1e6 * pgnSeconds / numGames
+              << " us per game to replay and encode the PGN\n";
+    
+    // Index the games, and look up where each of them ends.
+    const std::string plainArchive {ossPlain.str()};
+    const std::string indexFile {
+        outFile.empty() ? INDEX_TEST_FILE : outFile + ".idx"
+    };
+    timeStart = std::chrono::steady_clock::now();
+    writeIndex(plainArchive, indexFile);
+    timeEnd = std::chrono::steady_clock::now();
+    std::cout << "Index built in "
+              << std::chrono::duration<double>(timeEnd - timeStart).count()
+              << " s\n";
+    {
+        PositionIndex index {indexFile};
+        std::vector<Key> keys;
+        GameDecoder decoder {plainArchive};
+        MoveValidator validator;
+        std::vector<Move> moves;
+        while (decoder.nextGame() == ARCHIVE_OK) {
+            decoder.readMoves(moves);
+            keys.push_back(indexKey(decoder.getPosition(), validator));
+        }
+        std::size_t numMatches {0};
+        timeStart = std::chrono::steady_clock::now();
+        for (Key key : keys) {
+            numMatches += index.find(key).size();
+        }
+        timeEnd = std::chrono::steady_clock::now();
+        std::cout << index.getNumEntries() << " positions indexed ("
+                  << MappedFile {indexFile}.size() << " bytes), " << numMatches << " games found in "
+                  << keys.size() << " lookups, "
+                  << std::chrono::duration<double, std::micro>(
+                         timeEnd - timeStart).count() / keys.size()
+                  << " us per lookup\n";
+    }
+    if (outFile.empty()) {
+        std::remove(INDEX_TEST_FILE);
+    } else {
+        // The archive the index was built from, for its game offsets.
+        std::ofstream ofs {outFile, std::ios::binary};
+        ofs << plainArchive;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Run the archive tests with the command [filename] "
+                     "[EPD file path]\n"
+                     "or convert a PGN file with [filename] --pgn "
+                     "[PGN file path]\n"
+                     "Optional argument [] for atomic.\n"
+                     "Optional argument [--out FILE] to save the converted "
+                     "games.\n";
+        return 0;
+    }
+    
+    const std::string arg {argv[1]};
+    Variant var {ORTHO};
+    std::string outFile;
+    for (int i = (arg == "--pgn") ? 3 : 2; i < argc; ++i) {
+        const std::string opt {argv[i]};
+        if (opt == "--out" && i + 1 < argc) {
+            outFile = argv[++i];
+        } else {
+            var = ATOMIC;
+        }
+    }
+    if (arg == "--pgn") {
+        if (argc < 3) {
+            std::cout << "Missing PGN file path.\n";
+            return 1;
+        }
+        return runPgn(argv[2], var, outFile);
+    }
+    
+    std::ifstream testSuite {arg};
+    std::string strTest;
+    std::mt19937 rng {12345};
+    std::vector<Game> games;
+    while (std::getline(testSuite, strTest)) {
+        const std::string fen {strTest.substr(0, strTest.find(';'))};
+        for (int i = 0; i < GAMES_PER_POSITION; ++i) {
+            games.push_back(playRandomGame(fen, var, rng));
+        }
+    }
+    // Leave some games at the standard start without a FEN (the move
+    // counters are not part of the key).
+    const std::string_view startFields {
+        START_FEN.substr(0, START_FEN.rfind(" 0 "))
+    };
+    for (std::size_t i = 0; i < games.size(); i += 2) {
+        if (games[i].fen.rfind(startFields, 0) == 0) {
+            games[i].fen.clear();
+        }
+    }
+    
+    int numTests {0};
+    std::vector<int> idFails;
+    for (bool isIndexed : {false, true}) {
+        std::ostringstream oss;
+        GameEncoder encoder {oss, isIndexed};
+        bool isOk {true};
+        for (const Game& game : games) {
+            isOk &= encoder.addGame(game.var, game.fen, game.moves)
+                    == ARCHIVE_OK;
+        }
+        const std::string archive {oss.str()};
+        auto timeStart = std::chrono::steady_clock::now();
+        isOk = isOk && checkArchive(archive, games);
+        auto timeEnd = std::chrono::steady_clock::now();
+        ++numTests;
+        if (!isOk || !checkDamagedArchives(archive)) {
+            idFails.push_back(numTests);
+        }
+        std::cout << (isIndexed ? "Indexed" : "Plain") << ": "
+                  << games.size() << " games in " << archive.size()
+                  << " bytes, "
+                  << std::chrono::duration<double, std::micro>(
+                         timeEnd - timeStart).count() / games.size()
+                  << " us per game to load\n";
+    }
+    // Corrupt plain moves are refused on decoding.
+    ++numTests;
+    if (!checkCorruptMoves()) {
+        idFails.push_back(numTests);
+    }
+    // A corrupt FEN is refused on decoding, and the next game still loads.
+    ++numTests;
+    if (!checkCorruptFen()) {
+        idFails.push_back(numTests);
+    }
+    // An illegal move cannot be encoded, and leaves nothing in the archive.
+    for (bool isIndexed : {false, true}) {
+        std::ostringstream oss;
+        GameEncoder encoder {oss, isIndexed};
+        const std::size_t headerSize {oss.str().size()};
+        ++numTests;
+        if (encoder.addGame(ORTHO, "", {buildMove(SQ_E2, SQ_E4),
+                                        buildMove(SQ_E2, SQ_E5)})
+            != ARCHIVE_ILLEGAL_MOVE
+            || oss.str().size() != headerSize) {
+            idFails.push_back(numTests);
+        }
+    }
+    
+    // The position index, built from the plain archive.
+    {
+        std::ostringstream oss;
+        GameEncoder encoder {oss, false};
+        for (const Game& game : games) {
+            encoder.addGame(game.var, game.fen, game.moves);
+        }
+        const std::string archive {oss.str()};
+        writeIndex(archive, INDEX_TEST_FILE);
+        {
+            PositionIndex index {INDEX_TEST_FILE};
+            ++numTests;
+            if (!checkIndex(index, games)) {
+                idFails.push_back(numTests);
+            }
+            ++numTests;
+            if (!checkIndexLookups(index, archive, games)) {
+                idFails.push_back(numTests);
+            }
+        }
+        std::remove(INDEX_TEST_FILE);
+        ++numTests;
+        if (!checkIndexEnPassant()) {
+            idFails.push_back(numTests);
+        }
+        ++numTests;
+        if (!checkIndexSkipsBadGames()) {
+            idFails.push_back(numTests);
+        }
+        ++numTests;
+        if (!checkIndexTwoArchives()) {
+            idFails.push_back(numTests);
+        }
+    }
+    
+    // Print testing summary
+    int numFails = idFails.size();
+    float passRate = 100 * static_cast<float>(numTests - numFails)
+                     / static_cast<float>(numTests);
+    std::cout << "\n======= Summary =======\n";
+    std::cout << "Passrate = " << std::to_string(passRate) << "%\n";
+    if (idFails.size() > 0) {
+        std::cout << "Failed tests:";
+        for (int idFail: idFails) {
+            std::cout << " " << std::to_string(idFail);
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
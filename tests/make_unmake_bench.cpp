@@ -0,0 +1,87 @@
+#include "atomic_capture_masks.h"
+#include "atomic_position.h"
+#include "bitboard_lookup.h"
+#include "move.h"
+#include "move_validator.h"
+#include "ortho_position.h"
+#include "position.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Micro-benchmark of makeMove/unmakeMove alone, against copy-make.
+/// For each position (one FEN per line) the legal moves are generated once,
+/// then every move is made and unmade repeatedly; then every move is made
+/// without undo information and the saved state copied back. Reports the
+/// average time for one make/unmake pair and for one copy-make.
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Run the benchmark with the command [filename] "
+                     "[FEN file path] [Repetitions (default 20000)]\n"
+                     "Optional argument [] for atomic.\n";
+        return 0;
+    }
+    int reps {argc >= 3 ? std::atoi(argv[2]) : 20000};
+    Variant var {argc >= 4 ? ATOMIC : ORTHO};
+    
+    MoveValidator arbiter {var};
+    std::unique_ptr<Position> pos;
+    if (var == ORTHO) {
+        pos.reset(new OrthoPosition);
+    } else {
+        pos.reset(new AtomicPosition);
+    }
+    
+    std::ifstream ifs {argv[1]};
+    std::string strFen;
+    uint64_t numPairs {0};
+    uint64_t checksum {0};
+    std::chrono::steady_clock::duration timeTaken {};
+    std::chrono::steady_clock::duration timeTakenCopy {};
+    while (std::getline(ifs, strFen)) {
+        pos->fromFen(strFen);
+        Movelist mvlist {};
+        arbiter.generateLegalMoves(mvlist, *pos);
+        
+        auto timeStart = std::chrono::steady_clock::now();
+        for (int i = 0; i < reps; ++i) {
+            for (Move mv : mvlist) {
+                pos->makeMove(mv);
+                checksum += pos->getKey();
+                pos->unmakeMove(mv);
+            }
+        }
+        timeTaken += std::chrono::steady_clock::now() - timeStart;
+        
+        timeStart = std::chrono::steady_clock::now();
+        const PositionState saved {pos->getState()};
+        for (int i = 0; i < reps; ++i) {
+            for (Move mv : mvlist) {
+                pos->makeMoveNoUndo(mv);
+                checksum += pos->getKey();
+                pos->setState(saved);
+            }
+        }
+        timeTakenCopy += std::chrono::steady_clock::now() - timeStart;
+        numPairs += static_cast<uint64_t>(reps) * mvlist.size();
+    }
+    
+    double ns {std::chrono::duration<double, std::nano>(timeTaken).count()};
+    std::cout << "make/unmake pairs: " << std::to_string(numPairs) << "\n";
+    std::cout << "Time taken: " << ns / 1e6 << " ms\n";
+    std::cout << "Per pair: " << ns / numPairs << " ns\n";
+    double nsCopy {
+        std::chrono::duration<double, std::nano>(timeTakenCopy).count()
+    };
+    std::cout << "Copy-make time taken: " << nsCopy / 1e6 << " ms\n";
+    std::cout << "Per copy-make: " << nsCopy / numPairs << " ns\n";
+    std::cout << "(checksum " << std::to_string(checksum) << ")\n";
+    return 0;
+}
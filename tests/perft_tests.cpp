@@ -1,10 +1,13 @@
 #include "atomic_capture_masks.h"
 #include "atomic_position.h"
 #include "bitboard_lookup.h"
+#include "move.h"
+#include "move_picker.h"
 #include "move_validator.h"
 #include "ortho_position.h"
 #include "position.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
@@ -18,6 +21,217 @@
 /// perft(n), and compares to values from file.
 /// 
 
+uint64_t stagedPerft(MoveValidator& arbiter, int depth, Position& pos) {
+    /// Perft through the staged move picker, to check that the stages
+    /// together give exactly the legal moves.
+    if (depth == 0) {
+        return 1;
+    }
+    uint64_t nodes {0};
+    MovePicker picker {arbiter.getMovePicker(pos)};
+    Move mv {};
+    while (picker.next(mv)) {
+        pos.makeMove(mv);
+        nodes += stagedPerft(arbiter, depth - 1, pos);
+        pos.unmakeMove(mv);
+    }
+    return nodes;
+}
+
+template <typename NodeCheck>
+uint64_t checkedPerft(MoveValidator& arbiter, int depth, Position& pos,
+                      NodeCheck& check) {
+    /// Perft that also runs check(pos) at every node, leaves included,
+    /// through the full legal move list. Failed checks are counted in
+    /// check itself.
+    check(pos);
+    if (depth == 0) {
+        return 1;
+    }
+    uint64_t nodes {0};
+    for (Move mv : arbiter.generateLegalMoves(pos)) {
+        pos.makeMove(mv);
+        nodes += checkedPerft(arbiter, depth - 1, pos, check);
+        pos.unmakeMove(mv);
+    }
+    return nodes;
+}
+
+struct ResultCheck {
+    /// Checks that the early-exit hasLegalMove agrees with full generation,
+    /// and that gameResult is a win for the side not to move when it has no
+    /// moves and is in check (or, in atomic, has lost its king), a draw when
+    /// it has none otherwise, and no result while it has moves.
+    MoveValidator& arbiter;
+    uint64_t numFails {0};
+    
+    void operator()(Position& pos) {
+        const bool isEmpty {arbiter.generateLegalMoves(pos).empty()};
+        const Colour co {pos.getSideToMove()};
+        GameResult expected {NO_RESULT};
+        if (isEmpty && !pos.isVariantEnd() && !arbiter.isInCheck(co, pos)) {
+            expected = DRAW;
+        } else if (isEmpty) {
+            expected = (co == WHITE) ? BLACK_WINS : WHITE_WINS;
+        }
+        if (arbiter.hasLegalMove(pos) == isEmpty
+            || arbiter.gameResult(pos) != expected) {
+            ++numFails;
+        }
+    }
+};
+
+struct StageCheck {
+    /// Checks the staged generators against the full legal move list:
+    /// CAPTURES and QUIETS split it by whether a unit is taken, EVASIONS are
+    /// all of it when in check and none otherwise, and QUIET_CHECKS are the
+    /// quiets after which the opponent is in check. A captures-only picker
+    /// gives the captures, or every evasion when in check.
+    MoveValidator& arbiter;
+    uint64_t numFails {0};
+    
+    static std::vector<Move> sorted(const Movelist& mvlist) {
+        std::vector<Move> moves(mvlist.begin(), mvlist.end());
+        std::sort(moves.begin(), moves.end());
+        return moves;
+    }
+    
+    static bool isCaptureMove(Move mv, const Position& pos) {
+        // (Castling is encoded as the king taking its own rook.)
+        return isEp(mv)
+               || (!isCastling(mv) && pos.getMailbox(getToSq(mv)) != NO_PIECE);
+    }
+    
+    void operator()(Position& pos) {
+        const Colour co {pos.getSideToMove()};
+        const bool isCheck {arbiter.isInCheck(co, pos)};
+        Movelist all {};
+        Movelist captures {};
+        Movelist quiets {};
+        Movelist evasions {};
+        Movelist quietChecks {};
+        arbiter.generateLegalMoves(all, pos);
+        arbiter.generateLegalMoves(captures, pos, CAPTURES);
+        arbiter.generateLegalMoves(quiets, pos, QUIETS);
+        arbiter.generateLegalMoves(evasions, pos, EVASIONS);
+        arbiter.generateLegalMoves(quietChecks, pos, QUIET_CHECKS);
+        
+        bool isOk {true};
+        Movelist both {captures};
+        for (Move mv : quiets) {
+            isOk &= !isCaptureMove(mv, pos);
+            both.push_back(mv);
+        }
+        for (Move mv : captures) {
+            isOk &= isCaptureMove(mv, pos);
+        }
+        isOk &= sorted(both) == sorted(all);
+        isOk &= sorted(evasions) == (isCheck ? sorted(all)
+                                             : std::vector<Move> {});
+        
+        Movelist expectedChecks {};
+        for (Move mv : quiets) {
+            pos.makeMove(mv);
+            if (arbiter.isInCheck(!co, pos)) {
+                expectedChecks.push_back(mv);
+            }
+            pos.unmakeMove(mv);
+        }
+        isOk &= sorted(quietChecks) == sorted(expectedChecks);
+        
+        Movelist picked {};
+        MovePicker picker {arbiter.getMovePicker(pos, true)};
+        Move mv {};
+        while (picker.next(mv)) {
+            picked.push_back(mv);
+        }
+        isOk &= sorted(picked) == sorted(isCheck ? all : captures);
+        if (!isOk) {
+            ++numFails;
+        }
+    }
+};
+
+struct LegalityCheck {
+    /// Checks isLegal, one move at a time, on every valid move: each unit's
+    /// steps and captures, pawn pushes and promotions, and en passant. A
+    /// valid move must be legal exactly when it is among the legal moves.
+    /// (Valid castling is legal castling, so only the legal ones are tried.)
+    MoveValidator& arbiter;
+    uint64_t numFails {0};
+    
+    void operator()(Position& pos) {
+        const Colour co {pos.getSideToMove()};
+        const Bitboard bbAll {pos.getUnitsBb()};
+        const Bitboard bbFriendly {pos.getUnitsBb(co)};
+        Movelist valid {};
+        Bitboard bbFrom {bbFriendly};
+        while (bbFrom) {
+            const Square fromSq {popLsb(bbFrom)};
+            Bitboard bbTo {BB_NONE};
+            switch (getPieceType(pos.getMailbox(fromSq))) {
+            case PAWN: {
+                bbTo = pawnAttacks[co][fromSq] & pos.getUnitsBb(!co);
+                const Square pushSq {shiftForward(fromSq, co)};
+                if (!(pushSq & bbAll)) {
+                    bbTo |= pushSq;
+                    if ((fromSq & BB_OUR_2[co])
+                        && !(shiftForward(pushSq, co) & bbAll)) {
+                        bbTo |= shiftForward(pushSq, co);
+                    }
+                }
+                while (bbTo) {
+                    const Square toSq {popLsb(bbTo)};
+                    if (!(toSq & BB_OUR_8[co])) {
+                        valid.push_back(buildMove(fromSq, toSq));
+                        continue;
+                    }
+                    for (PieceType pcty : {KNIGHT, BISHOP, ROOK, QUEEN}) {
+                        valid.push_back(buildPromotion(fromSq, toSq, pcty));
+                    }
+                }
+                continue;
+            }
+            case KNIGHT: bbTo = knightAttacks[fromSq]; break;
+            case BISHOP: bbTo = findBishopAttacks(fromSq, bbAll); break;
+            case ROOK: bbTo = findRookAttacks(fromSq, bbAll); break;
+            case QUEEN:
+                bbTo = findBishopAttacks(fromSq, bbAll)
+                       | findRookAttacks(fromSq, bbAll);
+                break;
+            case KING: bbTo = kingAttacks[fromSq]; break;
+            default: break;
+            }
+            bbTo &= ~bbFriendly;
+            while (bbTo) {
+                valid.push_back(buildMove(fromSq, popLsb(bbTo)));
+            }
+        }
+        const Square epSq {pos.getEpSq()};
+        if (epSq != NO_SQ) {
+            Bitboard bbEp {pawnAttacks[!co][epSq] & pos.getUnitsBb(co, PAWN)};
+            while (bbEp) {
+                valid.push_back(buildEp(popLsb(bbEp), epSq));
+            }
+        }
+        const Movelist legal {arbiter.generateLegalMoves(pos)};
+        for (Move mv : legal) {
+            if (isCastling(mv)) {
+                valid.push_back(mv);
+            }
+        }
+        for (Move mv : valid) {
+            const bool isListed {
+                std::find(legal.begin(), legal.end(), mv) != legal.end()
+            };
+            if (arbiter.isLegal(mv, pos) != isListed) {
+                ++numFails;
+                return;
+            }
+        }
+    }
+};
+
 class SingleTest {
     /// Class representing a single test (position) from a single line in EPD.
     /// 
@@ -26,13 +240,25 @@ class SingleTest {
     std::vector<int> depths;
     std::vector<uint64_t> correctPerfts;
     MoveValidator arbiter;
+    bool isStaged;
+    bool isCheckingResults;
+    bool isCheckingStages;
+    bool isCheckingLegality;
     
-    SingleTest(std::istringstream& issline, Variant var) : arbiter(var) {
+    SingleTest(std::istringstream& issline, Variant var, PerftMode mode,
+               bool isBulkCounting, bool isStaged, bool isCheckingResults,
+               bool isCheckingStages, bool isCheckingLegality)
+        : arbiter(var), isStaged(isStaged),
+          isCheckingResults(isCheckingResults),
+          isCheckingStages(isCheckingStages),
+          isCheckingLegality(isCheckingLegality) {
         /// Parse a single line passed from EPD.
         /// Each line should consist of the full FEN description of the position
         /// followed by substrings of the form "D[depth] [perft]", separated by
         /// semicolons ";".
         
+        arbiter.setPerftMode(mode);
+        arbiter.setBulkCounting(isBulkCounting);
         std::string str;
         // Set FEN string
         std::getline(issline, strFen, ';');
@@ -47,7 +273,7 @@ class SingleTest {
         }
     }
     
-    bool run(int maxDepth) {
+    bool run(int maxDepth, int numThreads) {
         /// Runs perft to all depths smaller than maxDepth, printing results.
         /// 
         // TODO: can separate printing from logic.
@@ -66,13 +292,48 @@ class SingleTest {
                 continue;
             }
             pos->fromFen(strFen);
-            uint64_t res = arbiter.perft(depths[i], *pos);
+            uint64_t res {0};
+            if (isStaged) {
+                res = stagedPerft(arbiter, depths[i], *pos);
+            } else if (isCheckingResults) {
+                ResultCheck resultCheck {arbiter};
+                res = checkedPerft(arbiter, depths[i], *pos, resultCheck);
+                if (resultCheck.numFails > 0) {
+                    std::cout << std::to_string(resultCheck.numFails)
+                              << " nodes with a wrong hasLegalMove or "
+                                 "gameResult\n";
+                    isTestCorrect = false;
+                }
+            } else if (isCheckingStages) {
+                StageCheck stageCheck {arbiter};
+                res = checkedPerft(arbiter, depths[i], *pos, stageCheck);
+                if (stageCheck.numFails > 0) {
+                    std::cout << std::to_string(stageCheck.numFails)
+                              << " nodes with wrong staged moves\n";
+                    isTestCorrect = false;
+                }
+            } else if (isCheckingLegality) {
+                LegalityCheck legalityCheck {arbiter};
+                res = checkedPerft(arbiter, depths[i], *pos, legalityCheck);
+                if (legalityCheck.numFails > 0) {
+                    std::cout << std::to_string(legalityCheck.numFails)
+                              << " nodes with a wrong isLegal\n";
+                    isTestCorrect = false;
+                }
+            } else if (numThreads == 1) {
+                res = arbiter.perft(depths[i], *pos);
+            } else {
+                for (auto split : arbiter.perftSplitParallel(depths[i], *pos,
+                                                             numThreads)) {
+                    res += split.second;
+                }
+            }
             uint64_t check = correctPerfts[i];
             std::cout << "perft at depth " << std::to_string(depths[i]) << ": "
                       << std::to_string(res)
                       << " (" << std::to_string(check) << ")" << "\n";
             
-            if (res != check) {
+            if (res != check || !isTestCorrect) {
                 isTestCorrect = false;
                 break;
             }
@@ -83,10 +344,24 @@ class SingleTest {
 
 
 int main(int argc, char* argv[]) {
-    if (argc != 3 && argc != 4) {
+    if (argc < 3) {
         std::cout << "Run the perft tests with the command [filename] "
                      "[EPD file path] [Maximum depth]\n"
-                     "Optional argument [] for atomic.\n";
+                     "Optional argument [] for atomic.\n"
+                     "Optional argument [--threads N] to run perft on N "
+                     "threads (0 for all hardware threads).\n"
+                     "Optional argument [--copy-make] to run perft with "
+                     "copy-make instead of make/unmake.\n"
+                     "Optional argument [--no-bulk] to make every leaf move "
+                     "instead of counting them.\n"
+                     "Optional argument [--staged] to run perft through the "
+                     "staged move picker.\n"
+                     "Optional argument [--results] to check hasLegalMove "
+                     "and gameResult at every node.\n"
+                     "Optional argument [--stages] to check each kind of "
+                     "staged generation at every node.\n"
+                     "Optional argument [--legality] to check isLegal on "
+                     "every valid move at every node.\n";
         return 0;
     }
     
@@ -101,10 +376,34 @@ int main(int argc, char* argv[]) {
     int testId = 0;
     int numTests = 0;
     std::vector<int> idFails;
-    Variant var {argc == 3 ? ORTHO : ATOMIC};
-    
-    initialiseBbLookup();
-    initialiseAtomicMasks();
+    Variant var {ORTHO};
+    int numThreads {1};
+    PerftMode mode {MAKE_UNMAKE};
+    bool isBulkCounting {true};
+    bool isStaged {false};
+    bool isCheckingResults {false};
+    bool isCheckingStages {false};
+    bool isCheckingLegality {false};
+    for (int i = 3; i < argc; ++i) {
+        std::string arg {argv[i]};
+        if (arg == "--threads" && i + 1 < argc) {
+            numThreads = std::atoi(argv[++i]);
+        } else if (arg == "--copy-make") {
+            mode = COPY_MAKE;
+        } else if (arg == "--no-bulk") {
+            isBulkCounting = false;
+        } else if (arg == "--staged") {
+            isStaged = true;
+        } else if (arg == "--results") {
+            isCheckingResults = true;
+        } else if (arg == "--stages") {
+            isCheckingStages = true;
+        } else if (arg == "--legality") {
+            isCheckingLegality = true;
+        } else {
+            var = ATOMIC;
+        }
+    }
     
     auto timeStart = std::chrono::steady_clock::now();
     // Run each test in the testSuite (parsed from EPD).
@@ -113,9 +412,11 @@ int main(int argc, char* argv[]) {
         ++testId;
         bool isTestCorrect = true;
         std::istringstream iss {strTest};
-        SingleTest test {iss, var};
+        SingleTest test {iss, var, mode, isBulkCounting, isStaged,
+                         isCheckingResults, isCheckingStages,
+                         isCheckingLegality};
         std::cout << "======= Test " << std::to_string(testId) << " =======\n";
-        isTestCorrect = test.run(maxDepth);
+        isTestCorrect = test.run(maxDepth, numThreads);
         if (!isTestCorrect) {
             idFails.push_back(testId);
         }
@@ -6,21 +6,37 @@
 
 #include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <utility>
 #include <vector>
 
 /// Rudimentary console I/O to allow testing of atomic chess perft values.
-///
+/// Optional arguments:
+/// [--hash N] enables hashed perft with an N MB transposition table,
+/// [--policy always|deeper] sets its replacement policy (default deeper),
+/// [--threads N] runs perft on N threads (0 for all hardware threads).
 
-int main() {
-    initialiseBbLookup();
-    initialiseAtomicMasks();
-    
+int main(int argc, char* argv[]) {
     MoveValidator arbiter;
     std::unique_ptr<Position> pos = std::make_unique<AtomicPosition>();
     arbiter.setVariant(ATOMIC);
+    int hashMb {0};
+    ReplacementPolicy policy {REPLACE_DEEPER};
+    int numThreads {1};
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg {argv[i]};
+        std::string val {argv[i + 1]};
+        if (arg == "--hash") {
+            hashMb = std::stoi(val);
+        } else if (arg == "--policy") {
+            policy = (val == "always") ? REPLACE_ALWAYS : REPLACE_DEEPER;
+        } else if (arg == "--threads") {
+            numThreads = std::stoi(val);
+        }
+    }
+    arbiter.setPerftTable(hashMb, policy);
     
     while (true) {
         std::cout << "Enter FEN position:\n";
@@ -38,8 +54,12 @@ int main() {
             
             std::cout << "Calculating...\r";
             
+            PerftTable* table {arbiter.getPerftTable()};
+            uint64_t probesBefore {table ? table->getProbes() : 0};
+            uint64_t hitsBefore {table ? table->getHits() : 0};
             auto timeStart = std::chrono::steady_clock::now();
-            std::vector<std::pair<Move, uint64_t> > res = arbiter.perftSplit(depth, *pos);
+            std::vector<std::pair<Move, uint64_t> > res =
+                arbiter.perftSplitParallel(depth, *pos, numThreads);
             auto timeEnd = std::chrono::steady_clock::now();
             auto timeTaken = timeEnd - timeStart;
             
@@ -54,6 +74,14 @@ int main() {
             }
             std::cout << "Total: " << std::to_string(total) << "\n";
             std::cout << "Time taken: " << std::chrono::duration<double, std::milli>(timeTaken).count() << " ms\n";
+            if (table) {
+                uint64_t probes {table->getProbes() - probesBefore};
+                uint64_t hits {table->getHits() - hitsBefore};
+                double hitRate {probes ? 100.0 * hits / probes : 0.0};
+                std::cout << "TT hits: " << std::to_string(hits) << " / "
+                          << std::to_string(probes) << " probes ("
+                          << hitRate << "%)\n";
+            }
         }
     }
     return 0;
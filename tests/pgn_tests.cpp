@@ -0,0 +1,312 @@
+#include "atomic_capture_masks.h"
+#include "atomic_position.h"
+#include "bitboard_lookup.h"
+#include "import_pipeline.h"
+#include "mapped_file.h"
+#include "move.h"
+#include "move_validator.h"
+#include "ortho_position.h"
+#include "pgn.h"
+#include "position.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Program to test PGN reading, and to time imports of PGN files.
+///
+/// With an EPD file, plays random games from each of its positions, writes
+/// them out as PGN (with comments, variations and NAGs mixed in), reads them
+/// back and checks that the same moves come out. Malformed games are mixed in
+/// too, which must each report their error without disturbing the others.
+///
+/// The same games then go through the import pipeline, which must hand them
+/// back in the same order, each with its result if it ends in mate,
+/// stalemate or an exploded king.
+///
+/// With --import, replays every game of a PGN file, printing the errors of
+/// each failing game and the import speed. Optional argument [--threads N]
+/// imports through the pipeline with N workers.
+
+constexpr int GAMES_PER_POSITION {20};
+constexpr int MAX_PLIES {200};
+constexpr int PIPELINE_THREADS {4};
+
+struct ExpectedGame {
+    PgnError err;
+    std::vector<Move> moves;
+    // Decided from the final position's legal moves, not by gameResult.
+    GameResult result {NO_RESULT};
+};
+
+std::string writeRandomGame(const std::string& fen, Variant var,
+                            std::mt19937& rng, ExpectedGame& expected) {
+    /// Plays random legal moves from fen, returning the game as PGN.
+    MoveValidator arbiter {var};
+    std::unique_ptr<Position> pos;
+    if (var == ATOMIC) {
+        pos = std::make_unique<AtomicPosition>();
+    } else {
+        pos = std::make_unique<OrthoPosition>();
+    }
+    pos->fromFen(fen);
+    std::ostringstream oss;
+    oss << "[Event \"Random game\"]\n"
+        << "[Variant \"" << (var == ATOMIC ? "Atomic" : "Standard") << "\"]\n"
+        << "[FEN \"" << fen << "\"]\n"
+        << "[SetUp \"1\"]\n\n";
+    int moveNum {1};
+    if (pos->getSideToMove() == BLACK) {
+        oss << "1...";
+    }
+    for (int ply = 0; ply < MAX_PLIES; ++ply) {
+        Movelist mvlist {};
+        arbiter.generateLegalMoves(mvlist, *pos);
+        if (mvlist.empty()) {
+            break;
+        }
+        const Move mv {mvlist[rng() % static_cast<unsigned>(mvlist.size())]};
+        if (pos->getSideToMove() == WHITE) {
+            oss << moveNum << ".";
+        }
+        // Vary the spacing after move numbers.
+        if (rng() % 2) {
+            oss << " ";
+        }
+        oss << toSan(mv, *pos, arbiter);
+        switch (rng() % 8) {
+            case 0: oss << " { [%clk 0:01:00] }"; break;
+            case 1: oss << " $1"; break;
+            case 2: oss << "!?"; break;
+            case 3: oss << " (" << moveNum << ". Zz9 {not SAN} (Yy8) )"; break;
+            case 4: oss << "\n; a rest-of-line comment\n"; break;
+            default: break;
+        }
+        oss << " ";
+        pos->makeMove(mv);
+        expected.moves.push_back(mv);
+        if (pos->getSideToMove() == WHITE) {
+            ++moveNum;
+        }
+    }
+    // The final position may end the game, even after MAX_PLIES.
+    if (arbiter.generateLegalMoves(*pos).empty()) {
+        const Colour co {pos->getSideToMove()};
+        if (!pos->isVariantEnd() && !arbiter.isInCheck(co, *pos)) {
+            expected.result = DRAW;
+        } else {
+            expected.result = (co == WHITE) ? BLACK_WINS : WHITE_WINS;
+        }
+    }
+    oss << "*\n\n";
+    return oss.str();
+}
+
+std::string writeMalformedGames(std::vector<ExpectedGame>& expected) {
+    /// Games that must fail, each with the moves played before the error.
+    const Move e2e4 {buildMove(SQ_E2, SQ_E4)};
+    const Move e7e5 {buildMove(SQ_E7, SQ_E5)};
+    const std::string games {
+        "[Event \"Illegal\"]\n\n1. e4 e5 2. Ke3 *\n\n"
+        "[Event \"Ambiguous\"]\n[FEN \"4k3/8/8/8/8/8/8/1N2KN2 w - - 0 1\"]\n"
+        "\n1. Nd2 *\n\n"
+        "[Event \"Not SAN\"]\n\n1. e4 e5 2. Zf3 *\n\n"
+        "[Event \"Bad FEN\"]\n[FEN \"8/8/8 w - - 0 1\"]\n\n1. e4 *\n\n"
+        "[Event \"No kings\"]\n[FEN \"8/8/8/8/8/8/4P3/8 w - - 0 1\"]\n\n"
+        "1. e4 *\n\n"
+        "[Event \"Exploded kings\"]\n[Variant \"Atomic\"]\n"
+        "[FEN \"8/8/8/8/8/8/4P3/8 w - - 0 1\"]\n\n1. e4 *\n\n"
+        "[Event \"Bad variant\"]\n[Variant \"Crazyhouse\"]\n\n1. e4 *\n\n"
+        "[Event \"Unterminated variation\"]\n\n1. e4 (1. d4 d5 *\n\n"
+    };
+    expected.push_back({PGN_ILLEGAL_MOVE, {e2e4, e7e5}});
+    expected.push_back({PGN_AMBIGUOUS_MOVE, {}});
+    expected.push_back({PGN_BAD_SAN, {e2e4, e7e5}});
+    expected.push_back({PGN_BAD_FEN, {}});
+    expected.push_back({PGN_BAD_FEN, {}});
+    expected.push_back({PGN_ILLEGAL_MOVE, {}});
+    expected.push_back({PGN_BAD_VARIANT, {}});
+    expected.push_back({PGN_UNTERMINATED, {e2e4}});
+    return games;
+}
+
+int runImport(const std::string& pgnFile, Variant var, int numThreads) {
+    /// Replays every game in the file, reporting errors game by game.
+    const MappedFile file {pgnFile};
+    uint64_t numGames {0};
+    auto report = [&numGames](PgnError err, std::size_t offset,
+                              std::size_t numMoves, std::string_view token) {
+        ++numGames;
+        if (err == PGN_OK) {
+            return;
+        }
+        // Shows at most the first line of the offending token.
+        std::cout << "Game " << numGames << " (byte " << offset << "), ply "
+                  << numMoves + 1 << ": " << describePgnError(err) << " \""
+                  << token.substr(0, std::min<std::size_t>(
+                         16, token.find('\n'))) << "\"\n";
+    };
+    ImportStats stats {};
+    auto timeStart = std::chrono::steady_clock::now();
+    if (numThreads > 0) {
+        ImportPipeline pipeline {numThreads, var};
+        stats = pipeline.run(file.view(), [&report](const ImportedGame& game) {
+            report(game.err, game.offset, game.moves.size(), game.errorToken);
+        });
+    } else {
+        PgnReader reader {file.view()};
+        GameReplayer replayer {var};
+        PgnGame game;
+        while (reader.nextGame(game)) {
+            const PgnError err {replayer.replay(game)};
+            report(err, game.offset, replayer.getMoves().size(),
+                   replayer.getErrorToken());
+            ++stats.numGames;
+            stats.numErrors += (err != PGN_OK);
+            stats.numMoves += replayer.getMoves().size();
+        }
+    }
+    auto timeEnd = std::chrono::steady_clock::now();
+    const double seconds {
+        std::chrono::duration<double>(timeEnd - timeStart).count()
+    };
+    std::cout << stats.numGames << " games (" << stats.numErrors
+              << " with errors), " << stats.numMoves << " moves, "
+              << file.size() << " bytes in " << seconds * 1000 << " ms\n"
+              << stats.numGames / seconds << " games/s, "
+              << stats.numMoves / seconds << " moves/s, "
+              << file.size() / seconds / 1e6 << " MB/s\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Run the PGN round-trip tests with the command [filename] "
+                     "[EPD file path]\n"
+                     "or time an import with [filename] --import "
+                     "[PGN file path]\n"
+                     "Optional argument [] for atomic (the default variant "
+                     "of games without a Variant tag, for imports).\n"
+                     "Optional argument [--threads N] to import through the "
+                     "pipeline with N workers.\n";
+        return 0;
+    }
+    
+    const std::string arg {argv[1]};
+    if (arg == "--import") {
+        if (argc < 3) {
+            std::cout << "Missing PGN file path.\n";
+            return 1;
+        }
+        Variant var {ORTHO};
+        int numThreads {0};
+        for (int i = 3; i < argc; ++i) {
+            const std::string opt {argv[i]};
+            if (opt == "--threads" && i + 1 < argc) {
+                numThreads = std::atoi(argv[++i]);
+            } else {
+                var = ATOMIC;
+            }
+        }
+        return runImport(argv[2], var, numThreads);
+    }
+    const Variant var {argc >= 3 ? ATOMIC : ORTHO};
+    
+    // Write the games: random games from each position, malformed ones in
+    // the middle.
+    std::ifstream testSuite {arg};
+    std::string strTest;
+    std::mt19937 rng {12345};
+    std::string pgn;
+    std::vector<ExpectedGame> expected;
+    while (std::getline(testSuite, strTest)) {
+        const std::string fen {strTest.substr(0, strTest.find(';'))};
+        for (int i = 0; i < GAMES_PER_POSITION; ++i) {
+            expected.push_back({PGN_OK, {}});
+            pgn += writeRandomGame(fen, var, rng, expected.back());
+        }
+        if (expected.size() == GAMES_PER_POSITION) {
+            pgn += writeMalformedGames(expected);
+        }
+    }
+    
+    // Read them back.
+    PgnReader reader {pgn};
+    GameReplayer replayer {ORTHO};
+    PgnGame game;
+    std::size_t numGames {0};
+    std::size_t numMoves {0};
+    std::vector<std::size_t> idFails;
+    auto timeStart = std::chrono::steady_clock::now();
+    while (reader.nextGame(game)) {
+        const PgnError err {replayer.replay(game)};
+        numMoves += replayer.getMoves().size();
+        if (numGames >= expected.size() || err != expected[numGames].err
+            || replayer.getMoves() != expected[numGames].moves) {
+            std::cout << "Game " << numGames + 1 << ": "
+                      << describePgnError(err) << " after "
+                      << replayer.getMoves().size() << " moves\n";
+            idFails.push_back(numGames + 1);
+        }
+        ++numGames;
+    }
+    auto timeEnd = std::chrono::steady_clock::now();
+    if (numGames != expected.size()) {
+        std::cout << "Read " << numGames << " games, expected "
+                  << expected.size() << "\n";
+        idFails.push_back(numGames);
+    }
+    
+    // The pipeline must give the same games, in the same order. Small
+    // batches make workers overtake each other.
+    ImportPipeline pipeline {PIPELINE_THREADS, ORTHO};
+    pipeline.setBatchSize(3);
+    std::size_t numPipelineGames {0};
+    pipeline.run(pgn, [&](const ImportedGame& imported) {
+        const std::size_t i {numPipelineGames++};
+        if (i >= expected.size() || imported.err != expected[i].err
+            || imported.moves != expected[i].moves
+            || imported.result != expected[i].result) {
+            std::cout << "Pipeline game " << i + 1 << ": "
+                      << describePgnError(imported.err) << " after "
+                      << imported.moves.size() << " moves\n";
+            idFails.push_back(i + 1);
+        }
+    });
+    if (numPipelineGames != expected.size()) {
+        std::cout << "Pipeline read " << numPipelineGames
+                  << " games, expected " << expected.size() << "\n";
+        idFails.push_back(numPipelineGames);
+    }
+    
+    // Print testing summary
+    const double seconds {
+        std::chrono::duration<double>(timeEnd - timeStart).count()
+    };
+    int numFails = idFails.size();
+    float passRate = 100 * static_cast<float>(expected.size() - numFails)
+                     / static_cast<float>(expected.size());
+    std::cout << "\n======= Summary =======\n";
+    std::cout << "Passrate = " << std::to_string(passRate) << "%\n";
+    if (idFails.size() > 0) {
+        std::cout << "Failed tests:";
+        for (std::size_t idFail: idFails) {
+            std::cout << " " << std::to_string(idFail);
+        }
+        std::cout << "\n";
+    }
+    std::cout << numGames << " games, " << numMoves << " moves in "
+              << seconds * 1000 << " ms (" << numGames / seconds
+              << " games/s)\n";
+    return 0;
+}
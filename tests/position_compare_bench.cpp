@@ -0,0 +1,144 @@
+#include "atomic_capture_masks.h"
+#include "atomic_position.h"
+#include "bitboard_lookup.h"
+#include "move.h"
+#include "move_validator.h"
+#include "ortho_position.h"
+#include "packed_position.h"
+#include "position.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Benchmark of packed position comparison. Packs every node of the perft
+/// trees of an EPD (or FEN) file, then compares each key against the next
+/// WINDOW keys (a stand-in for a hash bucket), three ways: scalar word
+/// compares, the packed operator==, and the batch findEqual. As the baseline,
+/// the same pairs are compared unpacked, with the PositionState comparison
+/// behind Position's operator==. The numbers of matches must agree.
+
+constexpr std::size_t WINDOW {64};
+
+void collectKeys(MoveValidator& arbiter, Position& pos, int depth,
+                 std::vector<PackedPosition>& keys,
+                 std::vector<PositionState>& states) {
+    keys.push_back(packPosition(pos));
+    states.push_back(pos.getState());
+    if (depth == 0) {
+        return;
+    }
+    Movelist mvlist {};
+    arbiter.generateLegalMoves(mvlist, pos);
+    for (Move mv : mvlist) {
+        pos.makeMove(mv);
+        collectKeys(arbiter, pos, depth - 1, keys, states);
+        pos.unmakeMove(mv);
+    }
+    return;
+}
+
+bool isEqualScalar(const PackedPosition& lhs, const PackedPosition& rhs) {
+    for (int i = 0; i < 4; ++i) {
+        if (lhs.words[i] != rhs.words[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Run the benchmark with the command [filename] "
+                     "[EPD file path] [Depth]\n"
+                     "Optional argument [] for atomic.\n";
+        return 0;
+    }
+    int depth {std::atoi(argv[2])};
+    Variant var {argc >= 4 ? ATOMIC : ORTHO};
+    
+    MoveValidator arbiter {var};
+    std::unique_ptr<Position> pos;
+    if (var == ORTHO) {
+        pos.reset(new OrthoPosition);
+    } else {
+        pos.reset(new AtomicPosition);
+    }
+    
+    // Only the FEN (up to the first ';') of each line is used.
+    std::ifstream ifs {argv[1]};
+    std::vector<PackedPosition> keys {};
+    std::vector<PositionState> states {};
+    std::string strLine;
+    while (std::getline(ifs, strLine)) {
+        pos->fromFen(strLine.substr(0, strLine.find(';')));
+        collectKeys(arbiter, *pos, depth, keys, states);
+    }
+    const std::size_t numKeys {keys.size()};
+    if (numKeys <= WINDOW) {
+        std::cout << "Too few positions; increase the depth.\n";
+        return 0;
+    }
+    const std::size_t numCompared {numKeys - WINDOW};
+    
+    auto timeStart = std::chrono::steady_clock::now();
+    uint64_t matchesUnpacked {0};
+    for (std::size_t i = 0; i < numCompared; ++i) {
+        for (std::size_t j = 1; j <= WINDOW; ++j) {
+            matchesUnpacked += (states[i] == states[i + j]);
+        }
+    }
+    auto timeUnpacked = std::chrono::steady_clock::now() - timeStart;
+    
+    timeStart = std::chrono::steady_clock::now();
+    uint64_t matchesScalar {0};
+    for (std::size_t i = 0; i < numCompared; ++i) {
+        for (std::size_t j = 1; j <= WINDOW; ++j) {
+            matchesScalar += isEqualScalar(keys[i], keys[i + j]);
+        }
+    }
+    auto timeScalar = std::chrono::steady_clock::now() - timeStart;
+    
+    timeStart = std::chrono::steady_clock::now();
+    uint64_t matchesPacked {0};
+    for (std::size_t i = 0; i < numCompared; ++i) {
+        for (std::size_t j = 1; j <= WINDOW; ++j) {
+            matchesPacked += (keys[i] == keys[i + j]);
+        }
+    }
+    auto timePacked = std::chrono::steady_clock::now() - timeStart;
+    
+    timeStart = std::chrono::steady_clock::now();
+    uint64_t matchesBatch {0};
+    bool isEqual[WINDOW];
+    for (std::size_t i = 0; i < numCompared; ++i) {
+        matchesBatch += markEqual(keys[i], &keys[i + 1], WINDOW, isEqual);
+    }
+    auto timeBatch = std::chrono::steady_clock::now() - timeStart;
+    
+    auto toMs = [](std::chrono::steady_clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    };
+    std::cout << "Keys: " << std::to_string(numKeys) << " ("
+              << std::to_string(numCompared * WINDOW) << " comparisons)\n";
+    std::cout << "Unpacked Position ==: " << toMs(timeUnpacked) << " ms\n";
+    std::cout << "Scalar: " << toMs(timeScalar) << " ms\n";
+    std::cout << "Packed ==: " << toMs(timePacked) << " ms\n";
+    std::cout << "Batch markEqual: " << toMs(timeBatch) << " ms\n";
+    if (matchesScalar != matchesPacked || matchesScalar != matchesBatch
+        || matchesScalar != matchesUnpacked) {
+        std::cout << "Match counts differ! (" << std::to_string(matchesScalar)
+                  << ", " << std::to_string(matchesPacked) << ", "
+                  << std::to_string(matchesBatch) << ", "
+                  << std::to_string(matchesUnpacked) << ")\n";
+        return 1;
+    }
+    std::cout << "Matches: " << std::to_string(matchesScalar) << "\n";
+    return 0;
+}
@@ -2,14 +2,17 @@
 #include "chess_types.h"
 #include "move.h"
 #include "ortho_position.h"
+#include "packed_position.h"
 #include "position.h"
 
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
+#include <iterator>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // Test format (each line):
@@ -77,7 +80,12 @@ class SingleMoveTest {
         bool isPassed = true;
         posTest.fromFen(strFenBefore);
         posTest.makeMove(mv);
-        if (posTest != posAfter) {
+        // The incrementally updated key must match one computed from scratch.
+        // The FEN writer must reproduce the expected FEN (the suite's move
+        // counters are not always right, so they are left out).
+        if (posTest != posAfter || posTest.getKey() != posAfter.getKey()
+            || packPosition(posTest) != packPosition(posAfter)
+            || stripCounters(posTest.toFen()) != stripCounters(strFenAfter)) {
             isPassed = false;
         }
         return isPassed;
@@ -88,13 +96,23 @@ class SingleMoveTest {
         posTest.fromFen(strFenBefore);
         posTest.makeMove(mv);
         posTest.unmakeMove(mv);
-        if (posTest != posBefore) {
+        if (posTest != posBefore || posTest.getKey() != posBefore.getKey()
+            || packPosition(posTest) != packPosition(posBefore)) {
             isPassed = false;
         }
         return isPassed;
     }
     
     private:
+    std::string stripCounters(const std::string& strFen) {
+        // Keeps the first four fields of the FEN.
+        std::size_t idx {0};
+        for (int i = 0; i < 4 && idx != std::string::npos; ++i) {
+            idx = strFen.find(' ', idx + 1);
+        }
+        return strFen.substr(0, idx);
+    }
+    
     // To refactor for future use if needed
     Square square(std::string cn) {
         //assert xn is of form "e5" or "c1" etc.
@@ -103,6 +121,63 @@ class SingleMoveTest {
     }
 };
 
+// Malformed FENs, each with the error parseFen must report for it.
+struct FenErrorTest {
+    std::string_view fen;
+    FenError err;
+};
+constexpr FenErrorTest FEN_ERROR_TESTS[] {
+    {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", FEN_OK},
+    {"4k3/8/8/8/8/8/8/4K3 w - -", FEN_OK},
+    {"4k3/8/8/8/8/8/8/4K3", FEN_BAD_SIDE},
+    {"4k3/8/8/8/8/8/8/4K2 w - - 0 1", FEN_BAD_BOARD},
+    {"4k3/8/8/8/8/8/8/4K4 w - - 0 1", FEN_BAD_BOARD},
+    {"4k3/8/8/8/8/8/4K3 w - - 0 1", FEN_BAD_BOARD},
+    {"4k3/8/8/8/8/8/8/8/4K3 w - - 0 1", FEN_BAD_BOARD},
+    {"4k3/8/8/8/8/8/8/4X3 w - - 0 1", FEN_BAD_BOARD},
+    {"8/8/8/8/8/8/4P3/8 w - - 0 1", FEN_BAD_KINGS},
+    {"4k3/8/8/8/8/8/8/8 w - - 0 1", FEN_BAD_KINGS},
+    {"4k3/8/8/8/8/8/8/3KK3 w - - 0 1", FEN_BAD_KINGS},
+    {"3kk3/8/8/8/8/8/8/4K3 b - - 0 1", FEN_BAD_KINGS},
+    {"4k3/8/8/8/8/8/8/P3K3 w - - 0 1", FEN_BAD_PAWNS},
+    {"p3k3/8/8/8/8/8/8/4K3 w - - 0 1", FEN_BAD_PAWNS},
+    {"4k3/8/8/8/8/8/8/4K3 x - - 0 1", FEN_BAD_SIDE},
+    {"4k3/8/8/8/8/8/8/4K3 wb - - 0 1", FEN_BAD_SIDE},
+    {"4k3/8/8/8/8/8/8/4K3 w KK - 0 1", FEN_BAD_CASTLING},
+    {"4k3/8/8/8/8/8/8/4K3 w X - 0 1", FEN_BAD_CASTLING},
+    {"4k3/8/8/8/8/8/8/4K3 w - e4 0 1", FEN_BAD_EP},
+    {"4k3/8/8/8/8/8/8/4K3 w - e 0 1", FEN_BAD_EP},
+    {"4k3/8/8/8/8/8/3P4/4K3 w - e3 0 1", FEN_BAD_EP},
+    {"4k3/8/8/8/3p4/8/8/4K3 b - e3 0 1", FEN_BAD_EP},
+    {"4k3/8/8/4p3/8/8/8/4K3 b - e6 0 1", FEN_BAD_EP},
+    {"4k3/4p3/8/4p3/8/8/8/4K3 w - e6 0 1", FEN_BAD_EP},
+    {"4k3/8/8/4p3/8/8/8/4K3 w - e6 0 1", FEN_OK},
+    {"4k3/8/8/8/4P3/8/8/4K3 b - e3 0 1", FEN_OK},
+    {"4k3/8/8/8/8/8/8/4K3 w - - x 1", FEN_BAD_COUNTERS},
+    {"4k3/8/8/8/8/8/8/4K3 w - - 0 1 extra", FEN_BAD_COUNTERS},
+    {"4k3/8/8/8/8/8/8/4K3 w - - 0 999999999", FEN_OK},
+    {"4k3/8/8/8/8/8/8/4K3 w - - 0 9999999999", FEN_BAD_COUNTERS},
+};
+
+std::vector<int> runFenErrorTests() {
+    // Returns the (1-based) ids of the FEN_ERROR_TESTS that failed. A
+    // rejected FEN must also leave the position reset.
+    std::vector<int> idFails;
+    OrthoPosition pos;
+    OrthoPosition posReset;
+    posReset.reset();
+    for (std::size_t i = 0; i < std::size(FEN_ERROR_TESTS); ++i) {
+        const FenErrorTest& test {FEN_ERROR_TESTS[i]};
+        const FenError err {pos.parseFen(test.fen)};
+        if (err != test.err || (err != FEN_OK
+                                && (pos != posReset
+                                    || pos.getKey() != posReset.getKey()))) {
+            idFails.push_back(static_cast<int>(i) + 1);
+        }
+    }
+    return idFails;
+}
+
 int main(int argc, char* argv[]) {
     if (argc != 3) {
         std::cout << "Run the perft tests with the command [filename] "
@@ -128,8 +203,6 @@ int main(int argc, char* argv[]) {
     int numTests = 0;
     std::vector<int> idFails;
     
-    initialiseBbLookup();
-    
     auto timeStart = std::chrono::steady_clock::now();
     // Run each test in the testSuite (parsed from EPD).
     while (std::getline(testSuite, strTest)) {
@@ -163,5 +236,17 @@ int main(int argc, char* argv[]) {
         }
     }
     std::cout << std::chrono::duration <double, std::milli> (timeTaken).count() << " ms\n";
+    
+    const std::vector<int> idFenFails {runFenErrorTests()};
+    std::cout << "Malformed FENs: "
+              << std::size(FEN_ERROR_TESTS) - idFenFails.size() << "/"
+              << std::size(FEN_ERROR_TESTS) << " passed\n";
+    if (idFenFails.size() > 0) {
+        std::cout << "Failed FEN tests:";
+        for (int idFail: idFenFails) {
+            std::cout << " " << std::to_string(idFail);
+        }
+        std::cout << "\n";
+    }
     return 0;
 }
@@ -0,0 +1,58 @@
+#ifndef ZOBRIST_INCLUDED
+#define ZOBRIST_INCLUDED
+
+#include "chess_types.h"
+
+#include <array>
+#include <cstdint>
+
+// === zobrist.h ===
+// Random keys for Zobrist hashing of positions. A position's key is the XOR of
+// the keys of each (piece, square), its castling rights, the file of its en
+// passant square (if any), the side to move if black, and its variant.
+//
+// The keys are generated at compile time from a fixed seed, so they are the
+// same in every build and need no initialisation.
+
+typedef uint64_t Key;
+
+struct ZobristKeys {
+    std::array<std::array<Key, NUM_SQUARES>, NUM_PIECES> pieces {};
+    std::array<Key, CASTLE_ALL + 1> castling {}; // indexed by CastlingRights
+    std::array<Key, 8> epFile {};
+    Key sideToMove {0};
+    std::array<Key, NUM_VARIANTS> variant {};
+};
+
+constexpr uint64_t zobristRand(uint64_t& s) {
+    // xorshift64* pseudorandom number generator.
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 2685821657736338717ULL;
+}
+
+constexpr ZobristKeys generateZobristKeys() {
+    ZobristKeys keys {};
+    uint64_t s {1070372};
+    for (int ipc = 0; ipc < NUM_PIECES; ++ipc) {
+        for (int isq = 0; isq < NUM_SQUARES; ++isq) {
+            keys.pieces[ipc][isq] = zobristRand(s);
+        }
+    }
+    for (int icr = 0; icr <= CASTLE_ALL; ++icr) {
+        keys.castling[icr] = zobristRand(s);
+    }
+    for (int ifile = 0; ifile < 8; ++ifile) {
+        keys.epFile[ifile] = zobristRand(s);
+    }
+    keys.sideToMove = zobristRand(s);
+    for (int ivar = 0; ivar < NUM_VARIANTS; ++ivar) {
+        keys.variant[ivar] = zobristRand(s);
+    }
+    return keys;
+}
+
+inline constexpr ZobristKeys ZOBRIST {generateZobristKeys()};
+
+#endif //#ifndef ZOBRIST_INCLUDED